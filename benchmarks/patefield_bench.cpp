@@ -0,0 +1,137 @@
+/* patefield_bench.cpp -- Benchmarks of the Patefield generators.
+ * Copyright 2022 R. Urlus
+ *
+ * The table cases take the arguments
+ *
+ *     {n_row = n_col, log10(n_total), skewed, n_threads}
+ *
+ * and report the number of generated tables and cells per second. The
+ * marginals are even or, when skewed, proportional to 1 / (i + 1)^1.5.
+ * With `PATEFIELD_ENABLE_STATS` the cases also report the kernel counters
+ * per drawn cell.
+ */
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include <patefield/patefield.hpp>
+#include <patefield/stats.hpp>
+
+namespace {
+
+/* Marginals of length `n` summing to `n_total`, every entry at least one. */
+template<typename T>
+std::vector<T> make_marginals(const size_t n, const int64_t n_total, const bool skewed) {
+    std::vector<double> weights(n);
+    for (size_t i = 0; i < n; i++) {
+        weights[i] = skewed ? 1.0 / std::pow(static_cast<double>(i + 1), 1.5) : 1.0;
+    }
+    const double weight_sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+    const int64_t spare = n_total - static_cast<int64_t>(n);
+    std::vector<T> sums(n);
+    int64_t assigned = 0;
+    for (size_t i = 0; i < n; i++) {
+        const int64_t extra = static_cast<int64_t>(std::floor(static_cast<double>(spare) * weights[i] / weight_sum));
+        sums[i] = static_cast<T>(1 + extra);
+        assigned += 1 + extra;
+    }
+    // the rounding remainder goes to the largest marginal
+    sums[0] = static_cast<T>(sums[0] + (n_total - assigned));
+    return sums;
+}
+
+int64_t pow10(const int64_t exponent) {
+    int64_t value = 1;
+    for (int64_t i = 0; i < exponent; i++) value *= 10;
+    return value;
+}
+
+template<typename T>
+void BM_GenerateTables(benchmark::State& state) {
+    const size_t n = static_cast<size_t>(state.range(0));
+    const int64_t n_total = pow10(state.range(1));
+    const bool skewed = state.range(2) != 0;
+    const size_t n_threads = static_cast<size_t>(state.range(3));
+    const std::vector<T> row_sums = make_marginals<T>(n, n_total, skewed);
+    const std::vector<T> col_sums = make_marginals<T>(n, n_total, skewed);
+    const size_t n_cells = n * n;
+    // roughly a million cells per iteration
+    const size_t n_tables = std::max<size_t>(std::min<size_t>(1000000 / n_cells, 4096), 1);
+    std::vector<T> result(n_tables * n_cells);
+
+    // builds the process-wide factorial table outside the timed region
+    patefield::generate_contingency_tables(
+        1, static_cast<T>(n), static_cast<T>(n), row_sums.data(), col_sums.data(), n_total, 1, 42, nullptr,
+        result.data()
+    );
+    patefield::reset_kernel_stats();
+    for (auto _ : state) {
+        patefield::generate_contingency_tables(
+            n_tables, static_cast<T>(n), static_cast<T>(n), row_sums.data(), col_sums.data(), n_total, n_threads,
+            42, nullptr, result.data()
+        );
+        benchmark::DoNotOptimize(result.data());
+        benchmark::ClobberMemory();
+    }
+    const double tables = static_cast<double>(state.iterations() * n_tables);
+    state.counters["tables/s"] = benchmark::Counter(tables, benchmark::Counter::kIsRate);
+    state.counters["cells/s"] = benchmark::Counter(tables * static_cast<double>(n_cells), benchmark::Counter::kIsRate);
+    if (patefield::kernel_stats_enabled()) {
+        const patefield::KernelStats stats = patefield::kernel_stats();
+        const double drawn = static_cast<double>(std::max<uint64_t>(stats.cells, 1));
+        state.counters["mode_accepts/cell"] = static_cast<double>(stats.mode_accepts) / drawn;
+        state.counters["walk_steps/cell"] = static_cast<double>(stats.walk_steps) / drawn;
+        state.counters["restarts/cell"] = static_cast<double>(stats.restarts) / drawn;
+        state.counters["early_exits/table"] = static_cast<double>(stats.early_exits) / std::max(tables, 1.0);
+    }
+}
+
+void table_arguments(benchmark::internal::Benchmark* bench) {
+    const int64_t max_threads = std::max<int64_t>(std::thread::hardware_concurrency(), 1);
+    for (const int64_t n : {2, 10, 100, 1000}) {
+        for (const int64_t log_total : {2, 4, 6, 9}) {
+            if (pow10(log_total) < n) {
+                continue;
+            }
+            for (const int64_t skewed : {0, 1}) {
+                for (int64_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+                    bench->Args({n, log_total, skewed, n_threads});
+                }
+            }
+        }
+    }
+    bench->ArgNames({"shape", "log10_total", "skewed", "threads"});
+}
+
+/* Time to compute the dense factorial table of `10^range(0)` entries. */
+void BM_FactorialTable(benchmark::State& state) {
+    const int64_t n_total = pow10(state.range(0));
+    for (auto _ : state) {
+        double* table = patefield::create_factorial_table(n_total);
+        benchmark::DoNotOptimize(table);
+        std::free(table);
+    }
+    state.counters["entries/s"] = benchmark::Counter(
+        static_cast<double>(state.iterations()) * static_cast<double>(n_total + 1), benchmark::Counter::kIsRate
+    );
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_GenerateTables, int)
+    ->Apply(table_arguments)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_GenerateTables, int64_t)
+    ->Apply(table_arguments)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_FactorialTable)->DenseRange(2, 8, 2)->ArgName("log10_total")->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,285 @@
+/* async.hpp -- Generate tables ahead of the consumer in a ring of buffers.
+ * Copyright 2022 R. Urlus
+ *
+ * A background thread generates the chunks in order into a fixed number of
+ * buffers while the caller processes the chunks generated before. When all
+ * buffers hold chunks that have not been released by the caller the
+ * producer waits, the memory used is bounded by the number of buffers.
+ */
+
+#ifndef INCLUDE_PATEFIELD_ASYNC_HPP_
+#define INCLUDE_PATEFIELD_ASYNC_HPP_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <patefield/commons.hpp>
+#include <patefield/factorial.hpp>
+#include <patefield/parallel.hpp>
+#include <patefield/patefield.hpp>
+
+namespace patefield {
+
+/* Generator that produces chunks of tables on a background thread.
+ *
+ *  Chunk `c` holds the tables [c * chunk_size, min((c + 1) * chunk_size, n_tables)),
+ *  table `i` is drawn from its own stream derived from `seed` and `i` such
+ *  that the tables are identical to those of `generate_contingency_tables`
+ *  with `reproducible = true`. The chunks are returned in order by `next`,
+ *  while the caller works on chunk `c` the producer generates the following
+ *  chunks into the other buffers. A buffer is reused once its `Chunk` has
+ *  been released or destroyed, with the default of two buffers this is
+ *  double buffering.
+ *
+ * Parameters
+ * ----------
+ * n_tables : number of tables to generate
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums, must be > 0, must outlive the generator
+ * n_col_sums : the column sums, must be > 0, must outlive the generator
+ * chunk_size : number of tables per chunk
+ * n_buffers : optional, default = 2, the number of chunks that can be
+ *             generated ahead or held by the caller, must be positive
+ * n_threads : optional, default = 1, the number of threads used to generate
+ *             a chunk, on top of the producer thread
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`,
+ *        see `seed()`.
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables
+ */
+template<typename T, isInt<T> = true>
+class AsyncGenerator {
+    enum class SlotState { free, filling, ready, taken };
+
+    struct Slot {
+        std::unique_ptr<T[]> data;
+        size_t chunk = 0;
+        SlotState state = SlotState::free;
+    };
+
+    T n_row_;
+    T n_col_;
+    const T* n_row_sums_;
+    const T* n_col_sums_;
+    int64_t n_total_;
+    size_t n_tables_;
+    size_t chunk_size_;
+    size_t n_threads_;
+    uint64_t seed_;
+    double* factorial_table_;
+    Kernel kernel_;
+    size_t n_chunks_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Slot> slots_;
+    size_t next_chunk_ = 0;
+    bool stop_ = false;
+    std::exception_ptr error_;
+    std::thread producer_;
+
+    void release(const size_t slot) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slots_[slot].state = SlotState::free;
+        }
+        cv_.notify_all();
+    }
+
+    void produce() {
+        const size_t n_slots = slots_.size();
+        const size_t block_size = static_cast<size_t>(n_row_) * static_cast<size_t>(n_col_);
+        try {
+            details::with_factorial_table(factorial_table_, n_total_, [&](const auto& table) {
+                for (size_t chunk = 0; chunk < n_chunks_; chunk++) {
+                    Slot& slot = slots_[chunk % n_slots];
+                    {
+                        // backpressure, wait until the caller has released the buffer
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        cv_.wait(lock, [&] { return stop_ || slot.state == SlotState::free; });
+                        if (stop_) {
+                            return;
+                        }
+                        slot.state = SlotState::filling;
+                        slot.chunk = chunk;
+                    }
+                    const size_t first = chunk * chunk_size_;
+                    const size_t n = std::min(chunk_size_, n_tables_ - first);
+                    T* result = slot.data.get();
+                    details::parallel_blocks(n_threads_, n, [&](const size_t, const size_t begin, const size_t end) {
+                        std::unique_ptr<int64_t[]> jwork(
+                            new int64_t[details::simd_lanes * static_cast<size_t>(n_col_)]
+                        );
+                        details::generate_table_range<T>(
+                            first + begin, end - begin, n_row_, n_col_, n_row_sums_, n_col_sums_, n_total_, seed_,
+                            table, result + begin * block_size, kernel_, jwork.get()
+                        );
+                    });
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        slot.state = SlotState::ready;
+                    }
+                    cv_.notify_all();
+                }
+            });
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = std::current_exception();
+        }
+        cv_.notify_all();
+    }
+
+ public:
+    /* A generated chunk, the buffer is returned to the generator on `release` or destruction. */
+    class Chunk {
+        AsyncGenerator* owner_ = nullptr;
+        size_t slot_ = 0;
+        size_t first_ = 0;
+        size_t n_tables_ = 0;
+        const T* data_ = nullptr;
+
+        friend class AsyncGenerator;
+        Chunk(AsyncGenerator* owner, const size_t slot, const size_t first, const size_t n_tables, const T* data) :
+            owner_{owner}, slot_{slot}, first_{first}, n_tables_{n_tables}, data_{data} {}
+
+     public:
+        Chunk() = default;
+        Chunk(Chunk&& other) noexcept { *this = std::move(other); }
+
+        Chunk& operator=(Chunk&& other) noexcept {
+            if (this != &other) {
+                release();
+                owner_ = other.owner_;
+                slot_ = other.slot_;
+                first_ = other.first_;
+                n_tables_ = other.n_tables_;
+                data_ = other.data_;
+                other.owner_ = nullptr;
+                other.data_ = nullptr;
+            }
+            return *this;
+        }
+
+        Chunk(const Chunk&) = delete;
+        Chunk& operator=(const Chunk&) = delete;
+        ~Chunk() { release(); }
+
+        /* False for the empty chunk returned after the last one. */
+        explicit operator bool() const { return data_ != nullptr; }
+
+        /* Index of the first table in the chunk. */
+        size_t first() const { return first_; }
+
+        /* Number of tables in the chunk. */
+        size_t size() const { return n_tables_; }
+
+        /* The tables, table `first() + k` starts at `data() + k * n_row * n_col`. */
+        const T* data() const { return data_; }
+
+        /* Return the buffer to the generator, `data()` is invalid afterwards. */
+        void release() {
+            if (owner_) {
+                owner_->release(slot_);
+                owner_ = nullptr;
+                data_ = nullptr;
+            }
+        }
+    };  // Chunk
+
+    AsyncGenerator(
+        const size_t n_tables,
+        const T n_row,
+        const T n_col,
+        const T* n_row_sums,
+        const T* n_col_sums,
+        const size_t chunk_size,
+        const size_t n_buffers = 2,
+        const size_t n_threads = 1,
+        const uint64_t seed = 0,
+        double* factorial_table = nullptr,
+        const Kernel kernel = Kernel::scalar
+    ) :
+        n_row_{n_row},
+        n_col_{n_col},
+        n_row_sums_{n_row_sums},
+        n_col_sums_{n_col_sums},
+        n_total_{details::check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums)},
+        n_tables_{n_tables},
+        chunk_size_{chunk_size},
+        n_threads_{n_threads},
+        seed_{details::resolve_seed(seed)},
+        factorial_table_{factorial_table},
+        kernel_{kernel},
+        n_chunks_{chunk_size > 0 ? (n_tables + chunk_size - 1) / chunk_size : 0} {
+        if (chunk_size == 0) {
+            throw InputError("patefield: chunk_size must be positive.\n");
+        }
+        if (n_buffers == 0) {
+            throw InputError("patefield: n_buffers must be positive.\n");
+        }
+        const size_t block_size = static_cast<size_t>(n_row) * static_cast<size_t>(n_col);
+        slots_.resize(std::min(n_buffers, std::max<size_t>(n_chunks_, 1)));
+        for (Slot& slot : slots_) {
+            slot.data.reset(new T[std::min(chunk_size, n_tables) * block_size]);
+        }
+        producer_ = std::thread([this] { produce(); });
+    }
+
+    AsyncGenerator(const AsyncGenerator&) = delete;
+    AsyncGenerator& operator=(const AsyncGenerator&) = delete;
+
+    /* Stop the producer, every `Chunk` must have been released or destroyed before. */
+    ~AsyncGenerator() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        producer_.join();
+    }
+
+    /* Wait for the next chunk.
+     *
+     *  Returns an empty chunk when all chunks have been returned and rethrows
+     *  the exception of the producer when generating the chunk failed.
+     *  Holding all `n_buffers` chunks while calling `next` blocks forever.
+     */
+    Chunk next() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (next_chunk_ >= n_chunks_) {
+            return Chunk();
+        }
+        const size_t chunk = next_chunk_;
+        const size_t index = chunk % slots_.size();
+        Slot& slot = slots_[index];
+        cv_.wait(lock, [&] { return error_ || (slot.state == SlotState::ready && slot.chunk == chunk); });
+        if (slot.state != SlotState::ready || slot.chunk != chunk) {
+            std::rethrow_exception(error_);
+        }
+        slot.state = SlotState::taken;
+        next_chunk_++;
+        const size_t first = chunk * chunk_size_;
+        return Chunk(this, index, first, std::min(chunk_size_, n_tables_ - first), slot.data.get());
+    }
+
+    /* Number of chunks. */
+    size_t n_chunks() const { return n_chunks_; }
+
+    /* The seed of the table streams, drawn when the generator was constructed with seed 0. */
+    uint64_t seed() const { return seed_; }
+};  // AsyncGenerator
+
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_ASYNC_HPP_
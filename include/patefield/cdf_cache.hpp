@@ -0,0 +1,209 @@
+/* cdf_cache.hpp -- Memoized conditional distributions of cells.
+ * Copyright 2022 R. Urlus
+ *
+ * For a fixed set of marginals the same remaining row sum, column sum
+ * and total (ia, id, ie) occur again and again, particularly in the first
+ * rows and columns. `CdfCache` stores the cumulative distribution of the
+ * cell for such a state such that drawing the cell reduces to a single
+ * uniform and a binary search. The cache is bounded by a memory budget
+ * and evicts the least recently used distribution.
+ */
+
+#ifndef INCLUDE_PATEFIELD_CDF_CACHE_HPP_
+#define INCLUDE_PATEFIELD_CDF_CACHE_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <patefield/commons.hpp>
+#include <patefield/rcont.hpp>
+#include <patefield/stats.hpp>
+#include <patefield/uniform.hpp>
+
+namespace patefield {
+
+/* Counters of a `CdfCache`
+ *
+ * hits : number of draws served from the cache
+ * misses : number of draws for which the distribution had to be computed
+ * evictions : number of distributions removed to stay within the budget
+ * bypassed : number of misses whose distribution exceeded the budget on its own
+ * entries : number of distributions currently stored
+ * bytes : approximate memory used by the stored distributions
+ */
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t bypassed = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+};
+
+namespace details {
+
+/* LRU cache of cell CDFs keyed on (ia, id, ie), not thread-safe. */
+class CdfCache {
+ public:
+    struct Key {
+        int64_t ia;
+        int64_t id;
+        int64_t ie;
+
+        bool operator==(const Key& other) const {
+            return ia == other.ia && id == other.id && ie == other.ie;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            uint64_t h = static_cast<uint64_t>(key.ia) * 0x9E3779B97F4A7C15ULL;
+            h ^= static_cast<uint64_t>(key.id) + 0x7F4A7C159E3779B9ULL + (h << 6) + (h >> 2);
+            h ^= static_cast<uint64_t>(key.ie) + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+            return static_cast<size_t>(h);
+        }
+    };
+
+    struct Entry {
+        Key key;
+        // smallest value in the support
+        int64_t lo;
+        // normalised cumulative probabilities over [lo, lo + cdf.size())
+        std::vector<double> cdf;
+    };
+
+ private:
+    typedef std::list<Entry> lru_list;
+    // approximate bookkeeping cost of an entry on top of the CDF
+    static constexpr size_t entry_overhead = sizeof(Entry) + 6 * sizeof(void*);
+
+    size_t memory_budget_;
+    lru_list entries_;
+    std::unordered_map<Key, lru_list::iterator, KeyHash> index_;
+    CacheStats stats_;
+
+    void evict_until(const size_t required) {
+        while (!entries_.empty() && stats_.bytes + required > memory_budget_) {
+            const Entry& last = entries_.back();
+            stats_.bytes -= last.cdf.size() * sizeof(double) + entry_overhead;
+            index_.erase(last.key);
+            entries_.pop_back();
+            stats_.evictions++;
+            stats_.entries--;
+        }
+    }
+
+ public:
+    /* memory_budget : the maximum number of bytes used by the stored distributions */
+    explicit CdfCache(const size_t memory_budget) : memory_budget_{memory_budget} {}
+
+    /* Return the distribution belonging to (ia, id, ie), computing it on a miss.
+     *
+     * Returns nullptr when the distribution does not fit in the budget.
+     */
+    template<typename Table>
+    const Entry* find(const int64_t ia, const int64_t id, const int64_t ie, const Table& factorial_table) {
+        const Key key{ia, id, ie};
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            stats_.hits++;
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return &(*it->second);
+        }
+        stats_.misses++;
+
+        const int64_t ic = ie - id;
+        const int64_t ib = ie - ia;
+        const int64_t ii = ib - id;
+        const int64_t lo = std::max<int64_t>(0, -ii);
+        const int64_t hi = std::min(ia, id);
+        const size_t n = static_cast<size_t>(hi - lo + 1);
+        const size_t required = n * sizeof(double) + entry_overhead;
+        if (required > memory_budget_) {
+            stats_.bypassed++;
+            return nullptr;
+        }
+        Entry entry{key, lo, std::vector<double>(n)};
+        const double base = factorial_table[ia] + factorial_table[ib] + factorial_table[ic] + factorial_table[id]
+            - factorial_table[ie];
+        double sumprb = 0.0;
+        for (size_t k = 0; k < n; k++) {
+            const int64_t v = lo + static_cast<int64_t>(k);
+            sumprb += std::exp(
+                base - factorial_table[v] - factorial_table[id - v] - factorial_table[ia - v]
+                - factorial_table[ii + v]);
+            entry.cdf[k] = sumprb;
+        }
+        if (!(sumprb > 0.0) || !std::isfinite(sumprb)) {
+            stats_.bypassed++;
+            return nullptr;
+        }
+        for (size_t k = 0; k < n; k++) {
+            entry.cdf[k] /= sumprb;
+        }
+        entry.cdf[n - 1] = 1.0;
+
+        evict_until(required);
+        entries_.push_front(std::move(entry));
+        index_.emplace(key, entries_.begin());
+        stats_.bytes += required;
+        stats_.entries++;
+        return &entries_.front();
+    }
+
+    /* Remove all distributions, the counters are retained. */
+    void clear() {
+        entries_.clear();
+        index_.clear();
+        stats_.bytes = 0;
+        stats_.entries = 0;
+    }
+
+    void reset_stats() {
+        const size_t entries = stats_.entries;
+        const size_t bytes = stats_.bytes;
+        stats_ = CacheStats();
+        stats_.entries = entries;
+        stats_.bytes = bytes;
+    }
+
+    size_t memory_budget() const { return memory_budget_; }
+    const CacheStats& stats() const { return stats_; }
+};  // CdfCache
+
+/* CachedCdf draws the entry of a cell by inversion of a cached CDF.
+ *
+ *   Cell strategy for `rcont2`, falls back to `ModeWalk` for
+ *   distributions that do not fit in the budget of the cache.
+ */
+struct CachedCdf {
+    CdfCache* cache;
+    ModeWalk fallback;
+    OpenUniform uni_dist;
+
+    explicit CachedCdf(CdfCache* cache) : cache{cache} {}
+
+    template<typename T, typename Table, isInt<T> = true>
+    inline T draw(const T ia, const T id, const T ie, const Table& factorial_table, pcg64_dxsm& rng) {
+        const CdfCache::Entry* entry = cache->find(ia, id, ie, factorial_table);
+        if (!entry) {
+            return fallback.template draw<T>(ia, id, ie, factorial_table, rng);
+        }
+        const double r = uni_dist(rng);
+        count_stat(Stat::rng_draws);
+        const auto it = std::lower_bound(entry->cdf.begin(), entry->cdf.end(), r);
+        return static_cast<T>(entry->lo + (it - entry->cdf.begin()));
+    }
+};  // CachedCdf
+
+}  // namespace details
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_CDF_CACHE_HPP_
@@ -4,7 +4,14 @@
 #ifndef INCLUDE_PATEFIELD_COMMONS_HPP_
 #define INCLUDE_PATEFIELD_COMMONS_HPP_
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+#include <atomic>
+#include <cstdint>
 #include <random>  // random_device
+#include <stdexcept>
 
 #include <pcg_random.hpp>
 #include <pcg_extras.hpp>
@@ -22,5 +29,105 @@ class InputError : public std::runtime_error {
 typedef pcg_engines::setseq_dxsm_128_64 pcg64_dxsm;
 typedef pcg_extras::seed_seq_from<std::random_device> pcg_seed_seq;
 
+/* Kernel used by the batch generators.
+ *
+ * scalar : `rcont2`, one table at a time
+ * simd : `rcont2_simd`, multiple tables in lockstep, one per SIMD lane
+ */
+enum class Kernel : int { scalar = 0, simd = 1 };
+
+/* Memory layout of the generated tables.
+ *
+ * column_major : cell (i, j) of a table at `i + j * n_row`, the layout of `rcont2`
+ * row_major : cell (i, j) of a table at `i * n_col + j`, written sequentially
+ * cell_major : batches are stored cell by cell, cell (i, j) of table `t`
+ *              at `(i * n_col + j) * n_tables + t`
+ */
+enum class Layout : int { column_major = 0, row_major = 1, cell_major = 2 };
+
+namespace details {
+
+/* Number of forks of the process, engines seeded before a fork are reseeded in the child. */
+inline std::atomic<uint64_t>& fork_generation() {
+    static std::atomic<uint64_t> generation{0};
+#if defined(__unix__) || defined(__APPLE__)
+    static const int registered = pthread_atfork(nullptr, nullptr, [] {
+        fork_generation().fetch_add(1, std::memory_order_relaxed);
+    });
+    (void)registered;
+#endif
+    return generation;
+}
+
+/* Engine of the calling thread, seeded from random_device on first use.
+ *
+ *  Unseeded calls draw their seeds from this engine such that the entropy
+ *  source is only queried once per thread, and again after a fork.
+ */
+inline pcg64_dxsm& thread_engine() {
+    thread_local pcg64_dxsm engine;
+    thread_local bool seeded = false;
+    thread_local uint64_t generation = 0;
+    const uint64_t current = fork_generation().load(std::memory_order_relaxed);
+    if (!seeded || generation != current) {
+        pcg_seed_seq seed_source;
+        engine.seed(seed_source);
+        seeded = true;
+        generation = current;
+    }
+    return engine;
+}
+
+/* Draw a non-zero seed from `rng`. */
+inline uint64_t draw_seed(pcg64_dxsm& rng) {
+    uint64_t seed = rng();
+    while (seed == 0) {
+        seed = rng();
+    }
+    return seed;
+}
+
+/* Return `seed` or, when it is zero, a seed drawn from `thread_engine`. */
+inline uint64_t resolve_seed(const uint64_t seed) {
+    if (seed != 0) {
+        return seed;
+    }
+    return draw_seed(thread_engine());
+}
+
+/* Seed `rng` with the stream belonging to table `index`.
+ *
+ * Each table gets its own stream of the PCG family which only depends on
+ * `seed` and `index`, not on which thread generates the table.
+ */
+inline void seed_table_stream(pcg64_dxsm& rng, const uint64_t seed, const uint64_t index) {
+    rng.seed(seed, index);
+}
+
+/* Distance between consecutive rows and columns of a table. */
+struct CellStrides {
+    size_t row;
+    size_t col;
+};
+
+/* The strides of a table in a batch of `n_tables` stored using `layout`. */
+inline CellStrides cell_strides(const Layout layout, const size_t n_row, const size_t n_col, const size_t n_tables) {
+    switch (layout) {
+        case Layout::row_major:
+            return {n_col, 1};
+        case Layout::cell_major:
+            return {n_col * n_tables, n_tables};
+        default:
+            return {1, n_row};
+    }
+}
+
+/* Offset of the first cell of table `index` in a batch stored using `layout`. */
+inline size_t table_offset(const Layout layout, const size_t index, const size_t block_size) {
+    return layout == Layout::cell_major ? index : index * block_size;
+}
+
+}  // namespace details
+
 }  // namespace patefield
 #endif  // INCLUDE_PATEFIELD_COMMONS_HPP_
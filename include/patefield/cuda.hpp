@@ -0,0 +1,340 @@
+/* cuda.hpp -- Generate tables and their statistics on a CUDA device.
+ * Copyright 2022 R. Urlus
+ *
+ * Every device thread draws one table from the stream given by the seed and
+ * the index of the table, the streams of the reproducible mode of
+ * `generate_contingency_tables`. The statistics are computed on the device
+ * such that only a double per table, or a single count, is copied back.
+ * Requires the library to be built with `PATEFIELD_ENABLE_CUDA`, otherwise
+ * the functions throw a `std::runtime_error`.
+ *
+ * The device computes `exp` and `log` with its own math library, these can
+ * differ in the last bit from the host. The tables follow the same
+ * distribution as those of the host but a table can, rarely, differ from
+ * the host table with the same index.
+ */
+
+#ifndef INCLUDE_PATEFIELD_CUDA_HPP_
+#define INCLUDE_PATEFIELD_CUDA_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <patefield/commons.hpp>
+#include <patefield/cuda_backend.hpp>
+#include <patefield/factorial.hpp>
+#include <patefield/patefield.hpp>
+#include <patefield/statistics.hpp>
+
+namespace patefield {
+
+/* True when the library is built with the CUDA backend. */
+constexpr bool cuda_enabled() {
+#if defined(PATEFIELD_HAS_CUDA_SUPPORT)
+    return true;
+#else
+    return false;
+#endif
+}
+
+namespace details {
+
+/* Complete `job` with the marginals and the log-factorials and run it. */
+template<typename T, isInt<T> = true>
+inline void launch_cuda_job(
+    CudaJob job,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const int64_t n_total,
+    const double* factorial_table
+) {
+    const std::vector<int64_t> row_sums(n_row_sums, n_row_sums + n_row);
+    const std::vector<int64_t> col_sums(n_col_sums, n_col_sums + n_col);
+    job.n_row = static_cast<int64_t>(n_row);
+    job.n_col = static_cast<int64_t>(n_col);
+    job.n_row_sums = row_sums.data();
+    job.n_col_sums = col_sums.data();
+    job.n_total = n_total;
+    job.seed = resolve_seed(job.seed);
+    if (factorial_table) {
+        job.factorial_table = factorial_table;
+        job.n_stored = n_total;
+        run_cuda_job(job);
+        return;
+    }
+    // the device evaluates the Stirling series beyond the stored arguments, as `LogFactorial`
+    const LogFactorial shared = shared_log_factorials(n_total);
+    job.factorial_table = shared.data();
+    job.n_stored = shared.n_stored();
+    run_cuda_job(job);
+}  // launch_cuda_job
+
+template<typename T, isInt<T> = true>
+inline T* generate_contingency_tables_cuda(
+    const size_t n_tables,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    int64_t n_total = 0,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    T* result = nullptr,
+    const int device = 0
+) {
+    if (n_total == 0) {
+        n_total = check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums);
+    }
+    const size_t block_size = static_cast<size_t>(n_row) * static_cast<size_t>(n_col);
+    if (!result) {
+        result = reinterpret_cast<T*>(std::malloc(block_size * sizeof(T) * n_tables));
+        if (!result) throw std::bad_alloc();
+    }
+    CudaJob job;
+    job.n_tables = n_tables;
+    job.seed = seed;
+    job.device = device;
+    job.tables = result;
+    job.int_tables = sizeof(T) < sizeof(int64_t);
+    launch_cuda_job<T>(job, n_row, n_col, n_row_sums, n_col_sums, n_total, factorial_table);
+    return result;
+}  // generate_contingency_tables_cuda
+
+/* Job computing `statistic` per table, the outputs are set by the caller. */
+template<typename T, isInt<T> = true>
+inline CudaJob cuda_statistic_job(
+    const size_t n_tables,
+    const TableStatistic<T>& table_statistic,
+    const uint64_t seed,
+    const int device
+) {
+    CudaJob job;
+    job.n_tables = n_tables;
+    job.seed = seed;
+    job.device = device;
+    job.statistic = static_cast<int>(table_statistic.statistic());
+    job.inv_expected = table_statistic.inv_expected();
+    job.g_offset = table_statistic.g_offset();
+    job.cramers_scale = table_statistic.cramers_scale();
+    return job;
+}  // cuda_statistic_job
+
+template<typename T, isInt<T> = true>
+inline double* generate_statistics_cuda(
+    const size_t n_tables,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total = 0,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    double* result = nullptr,
+    const int device = 0
+) {
+    if (n_total == 0) {
+        n_total = check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums);
+    }
+    if (!result) {
+        result = reinterpret_cast<double*>(std::malloc(n_tables * sizeof(double)));
+        if (!result) throw std::bad_alloc();
+    }
+    const TableStatistic<T> table_statistic(statistic, n_row, n_col, n_row_sums, n_col_sums, n_total);
+    CudaJob job = cuda_statistic_job<T>(n_tables, table_statistic, seed, device);
+    job.statistics = result;
+    launch_cuda_job<T>(job, n_row, n_col, n_row_sums, n_col_sums, n_total, factorial_table);
+    return result;
+}  // generate_statistics_cuda
+
+template<typename T, isInt<T> = true>
+inline uint64_t count_statistics_cuda(
+    const size_t n_tables,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const Statistic statistic,
+    const double threshold,
+    int64_t n_total = 0,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const int device = 0
+) {
+    if (n_total == 0) {
+        n_total = check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums);
+    }
+    const TableStatistic<T> table_statistic(statistic, n_row, n_col, n_row_sums, n_col_sums, n_total);
+    uint64_t count = 0;
+    CudaJob job = cuda_statistic_job<T>(n_tables, table_statistic, seed, device);
+    job.count = &count;
+    job.threshold = threshold;
+    launch_cuda_job<T>(job, n_row, n_col, n_row_sums, n_col_sums, n_total, factorial_table);
+    return count;
+}  // count_statistics_cuda
+
+}  // namespace details
+
+/* Number of CUDA devices, zero without CUDA support or without a device. */
+int cuda_device_count();
+
+/* Generate `n_tables` random two-way contingency tables on a CUDA device.
+ *
+ *  Table `i` is drawn from its own stream derived from `seed` and `i`, the
+ *  streams of `generate_contingency_tables` with `reproducible = true`.
+ *
+ * Parameters
+ * ----------
+ * n_tables : number of tables to generate
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * n_total : optional, default = 0, the sum of the column or row sums
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ * result : optional, pointer to the memory where the tables will be stored,
+ *          must be of size [n_tables * n_row * n_col], column major per table
+ * device : optional, default = 0, the index of the CUDA device
+ *
+ *  Returns
+ *  -------
+ *  result : pointer to the memory where the tables have been stored
+ */
+int* generate_contingency_tables_cuda(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total = 0,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    int* result = nullptr,
+    const int device = 0
+);
+
+/* Generate `n_tables` random two-way contingency tables on a CUDA device.
+ *
+ *  See the `int` overload for the description of the arguments.
+ */
+int64_t* generate_contingency_tables_cuda(
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    int64_t n_total = 0,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    int64_t* result = nullptr,
+    const int device = 0
+);
+
+/* Generate `n_tables` random tables on a CUDA device and return their statistic.
+ *
+ *  The tables are those of `generate_contingency_tables_cuda`, only the
+ *  statistics are copied back from the device.
+ *
+ * Parameters
+ * ----------
+ * statistic : the statistic to compute
+ * result : optional, pointer to the memory of size [n_tables] where the
+ *          statistics will be stored
+ *
+ * See `generate_contingency_tables_cuda` for the other parameters.
+ *
+ *  Returns
+ *  -------
+ *  result : pointer to the memory where the statistics have been stored
+ */
+double* generate_statistics_cuda(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total = 0,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    double* result = nullptr,
+    const int device = 0
+);
+
+/* Generate `n_tables` random tables on a CUDA device and return their statistic.
+ *
+ *  See the `int` overload for the description of the arguments.
+ */
+double* generate_statistics_cuda(
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total = 0,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    double* result = nullptr,
+    const int device = 0
+);
+
+/* Number of random tables generated on a CUDA device whose statistic is at least `threshold`.
+ *
+ *  The counts are reduced on the device, e.g. the numerator of a Monte Carlo
+ *  p-value with `threshold` the statistic of the observed table.
+ *
+ * Parameters
+ * ----------
+ * statistic : the statistic to compute
+ * threshold : the tables with a statistic >= threshold are counted
+ *
+ * See `generate_contingency_tables_cuda` for the other parameters.
+ *
+ *  Returns
+ *  -------
+ *  count : the number of tables with a statistic >= threshold
+ */
+uint64_t count_statistics_cuda(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    const Statistic statistic,
+    const double threshold,
+    int64_t n_total = 0,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const int device = 0
+);
+
+/* Number of random tables generated on a CUDA device whose statistic is at least `threshold`.
+ *
+ *  See the `int` overload for the description of the arguments.
+ */
+uint64_t count_statistics_cuda(
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    const Statistic statistic,
+    const double threshold,
+    int64_t n_total = 0,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const int device = 0
+);
+
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_CUDA_HPP_
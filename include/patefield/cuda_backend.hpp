@@ -0,0 +1,66 @@
+/* cuda_backend.hpp -- Interface between the host code and the CUDA kernels.
+ * Copyright 2022 R. Urlus
+ *
+ * Only plain types cross this interface such that the device code is
+ * compiled without the PCG headers and the templates of the host code.
+ * The jobs are prepared in `cuda.hpp`, `details::cuda_statistic_job` sets the
+ * statistic and `details::launch_cuda_job` completes and runs them.
+ */
+
+#ifndef INCLUDE_PATEFIELD_CUDA_BACKEND_HPP_
+#define INCLUDE_PATEFIELD_CUDA_BACKEND_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace patefield {
+namespace details {
+
+/* A batch of tables to be generated on a device, the pointers are host memory.
+ *
+ * n_tables : number of tables, table `i` is drawn from the stream `(seed, i)`
+ * n_row, n_col : shape of the tables
+ * n_row_sums, n_col_sums : the marginals
+ * n_total : the sum of the marginals
+ * seed : the seed of the table streams
+ * factorial_table : log-factorials of [0, n_stored], larger arguments
+ *                   are computed with the Stirling series
+ * device : index of the CUDA device
+ * tables : optional, receives the tables in the layout of `rcont2`,
+ *          `int` when `int_tables` is set and `int64_t` otherwise
+ * statistic : value of the `Statistic` computed when `statistics` or `count` is set
+ * inv_expected, g_offset, cramers_scale : the terms of `TableStatistic`
+ * statistics : optional, receives the statistic of every table
+ * count : optional, receives the number of tables with a statistic >= threshold
+ */
+struct CudaJob {
+    size_t n_tables = 0;
+    int64_t n_row = 0;
+    int64_t n_col = 0;
+    const int64_t* n_row_sums = nullptr;
+    const int64_t* n_col_sums = nullptr;
+    int64_t n_total = 0;
+    uint64_t seed = 0;
+    const double* factorial_table = nullptr;
+    int64_t n_stored = 0;
+    int device = 0;
+    void* tables = nullptr;
+    bool int_tables = false;
+    int statistic = 0;
+    const double* inv_expected = nullptr;
+    double g_offset = 0.0;
+    double cramers_scale = 0.0;
+    double* statistics = nullptr;
+    uint64_t* count = nullptr;
+    double threshold = 0.0;
+};  // CudaJob
+
+/* Run `job` on its device, throws std::runtime_error when a CUDA call fails. */
+void run_cuda_job(const CudaJob& job);
+
+/* Number of CUDA devices, zero when there is no driver or device. */
+int count_cuda_devices();
+
+}  // namespace details
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_CUDA_BACKEND_HPP_
@@ -0,0 +1,494 @@
+/* exact.hpp -- Enumerate all tables with given marginals.
+ * Copyright 2022 R. Urlus
+ *
+ * For a small total the number of tables with the given marginals is small
+ * enough to visit each of them once. Under independence table `N` has the
+ * multivariate hypergeometric probability
+ *
+ *     P(N) = prod r_i! prod c_j! / (n! prod n_ij!)
+ *
+ * which gives exact p-values and distributions where `rcont2` needs
+ * millions of draws for an estimate.
+ */
+
+#ifndef INCLUDE_PATEFIELD_EXACT_HPP_
+#define INCLUDE_PATEFIELD_EXACT_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <patefield/commons.hpp>
+#include <patefield/factorial.hpp>
+#include <patefield/patefield.hpp>
+#include <patefield/pvalue.hpp>
+#include <patefield/statistics.hpp>
+
+namespace patefield {
+
+/* Tables with given marginals and their probability.
+ *
+ * tables : table `k` starts at `tables[k * n_row * n_col]`, in the layout of the generators
+ * probabilities : the probability of table `k` under independence
+ * exact : true if the tables are all tables with the marginals, each listed once,
+ *         false if they are random tables with equal weights
+ */
+template<typename T, isInt<T> = true>
+struct TableDistribution {
+    std::vector<T> tables;
+    std::vector<double> probabilities;
+    bool exact = true;
+
+    /* Number of tables. */
+    size_t size() const { return probabilities.size(); }
+};  // TableDistribution
+
+namespace details {
+
+/* Factorial table of `count_tables`, only the tables are needed. */
+struct NoFactorials {
+    inline double operator[](const int64_t) const { return 0.0; }
+};
+
+/* Depth-first visit of every table with the given marginals.
+ *
+ *  The cells are filled row by row, every cell ranges over the values that
+ *  leave the remaining column sums reachable such that every branch ends in
+ *  a table. The last column of a row and the last row follow from the sums.
+ *  `visit(table, log_p)` returns false to stop the enumeration.
+ */
+template<typename T, typename Table, typename Visit>
+class TableEnumerator {
+    T n_row_;
+    T n_col_;
+    const T* n_row_sums_;
+    const Table& factorial_table_;
+    Visit& visit_;
+    std::vector<T> cells_;
+    std::vector<int64_t> col_left_;
+    bool stopped_ = false;
+
+    inline T& cell(const T l, const T m) { return cells_[l + m * static_cast<size_t>(n_row_)]; }
+
+    // cell (l, m) with `a` left of row `l` and `log_p` the log probability of the cells set so far
+    void fill(const T l, const T m, const int64_t a, const double log_p) {
+        if (l == n_row_ - 1) {
+            double last_log_p = log_p;
+            for (T j = 0; j < n_col_; j++) {
+                cell(l, j) = static_cast<T>(col_left_[j]);
+                last_log_p -= factorial_table_[col_left_[j]];
+            }
+            stopped_ = !visit_(static_cast<const T*>(cells_.data()), last_log_p);
+            return;
+        }
+        if (m == n_col_ - 1) {
+            cell(l, m) = static_cast<T>(a);
+            col_left_[m] -= a;
+            fill(static_cast<T>(l + 1), 0, static_cast<int64_t>(n_row_sums_[l + 1]), log_p - factorial_table_[a]);
+            col_left_[m] += a;
+            return;
+        }
+        int64_t rest = 0;
+        for (T k = static_cast<T>(m + 1); k < n_col_; k++) {
+            rest += col_left_[k];
+        }
+        const int64_t lower = std::max<int64_t>(a - rest, 0);
+        const int64_t upper = std::min(a, col_left_[m]);
+        for (int64_t value = lower; value <= upper && !stopped_; value++) {
+            cell(l, m) = static_cast<T>(value);
+            col_left_[m] -= value;
+            fill(l, static_cast<T>(m + 1), a - value, log_p - factorial_table_[value]);
+            col_left_[m] += value;
+        }
+    }
+
+ public:
+    TableEnumerator(
+        const T n_row,
+        const T n_col,
+        const T* n_row_sums,
+        const T* n_col_sums,
+        const Table& factorial_table,
+        Visit& visit
+    ) :
+        n_row_{n_row},
+        n_col_{n_col},
+        n_row_sums_{n_row_sums},
+        factorial_table_{factorial_table},
+        visit_{visit},
+        cells_(static_cast<size_t>(n_row) * static_cast<size_t>(n_col)),
+        col_left_(n_col_sums, n_col_sums + n_col) {}
+
+    void run(const int64_t n_total) {
+        // log(prod r_i! prod c_j! / n!), the cells subtract their log factorial
+        double log_p = -factorial_table_[n_total];
+        for (T i = 0; i < n_row_; i++) {
+            log_p += factorial_table_[n_row_sums_[i]];
+        }
+        for (T j = 0; j < n_col_; j++) {
+            log_p += factorial_table_[col_left_[j]];
+        }
+        fill(0, 0, static_cast<int64_t>(n_row_sums_[0]), log_p);
+    }
+};  // TableEnumerator
+
+template<typename T, typename Table, typename Visit, isInt<T> = true>
+inline void enumerate_tables(
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const int64_t n_total,
+    const Table& factorial_table,
+    Visit&& visit
+) {
+    TableEnumerator<T, Table, Visit> enumerator(n_row, n_col, n_row_sums, n_col_sums, factorial_table, visit);
+    enumerator.run(n_total);
+}  // enumerate_tables
+
+template<typename T, isInt<T> = true>
+inline size_t count_tables(
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const size_t limit
+) {
+    const int64_t n_total = check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums);
+    size_t count = 0;
+    if (limit == 0) {
+        return count;
+    }
+    // every visited table is distinct, the cost is linear in the returned count
+    enumerate_tables<T>(
+        n_row, n_col, n_row_sums, n_col_sums, n_total, NoFactorials(), [&count, limit](const T*, const double) {
+            return ++count < limit;
+        }
+    );
+    return count;
+}  // count_tables
+
+template<typename T, isInt<T> = true>
+inline TableDistribution<T> enumerate_contingency_tables(
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const size_t max_tables = 1000000,
+    const size_t n_samples = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr
+) {
+    const int64_t n_total = check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums);
+    const size_t block_size = static_cast<size_t>(n_row) * static_cast<size_t>(n_col);
+    const size_t n_tables = count_tables<T>(n_row, n_col, n_row_sums, n_col_sums, max_tables + 1);
+    TableDistribution<T> result;
+    if (n_tables > max_tables) {
+        if (n_samples == 0) {
+            throw InputError("patefield: the number of tables exceeds max_tables.\n");
+        }
+        result.exact = false;
+        result.tables.resize(n_samples * block_size);
+        result.probabilities.assign(n_samples, 1.0 / static_cast<double>(n_samples));
+        generate_contingency_tables<T>(
+            n_samples, n_row, n_col, n_row_sums, n_col_sums, n_total, n_threads, seed, factorial_table,
+            result.tables.data(), true
+        );
+        return result;
+    }
+    result.tables.reserve(n_tables * block_size);
+    result.probabilities.reserve(n_tables);
+    with_factorial_table(factorial_table, n_total, [&](const auto& table) {
+        auto store = [&](const T* cells, const double log_p) {
+            result.tables.insert(result.tables.end(), cells, cells + block_size);
+            result.probabilities.push_back(std::exp(log_p));
+            return true;
+        };
+        enumerate_tables<T>(n_row, n_col, n_row_sums, n_col_sums, n_total, table, store);
+    });
+    return result;
+}  // enumerate_contingency_tables
+
+/* Exact p-value of `observed` over the tables with its marginals, `observed` has been checked. */
+template<typename T, isInt<T> = true>
+inline PValueResult exact_pvalue_impl(
+    const T* observed,
+    const T n_row,
+    const T n_col,
+    const std::vector<T>& n_row_sums,
+    const std::vector<T>& n_col_sums,
+    const int64_t n_total,
+    const Statistic statistic,
+    double* factorial_table
+) {
+    const TableStatistic<T> table_statistic(
+        statistic, n_row, n_col, n_row_sums.data(), n_col_sums.data(), n_total
+    );
+    PValueResult result;
+    result.statistic = table_statistic(observed);
+    const double threshold = extreme_threshold(result.statistic);
+    double pvalue = 0.0;
+    with_factorial_table(factorial_table, n_total, [&](const auto& table) {
+        auto accumulate = [&](const T* cells, const double log_p) {
+            result.n_tables++;
+            if (table_statistic(cells) >= threshold) {
+                result.n_extreme++;
+                pvalue += std::exp(log_p);
+            }
+            return true;
+        };
+        enumerate_tables<T>(n_row, n_col, n_row_sums.data(), n_col_sums.data(), n_total, table, accumulate);
+    });
+    result.pvalue = std::min(pvalue, 1.0);
+    result.lower = result.pvalue;
+    result.upper = result.pvalue;
+    result.converged = true;
+    result.exact = true;
+    return result;
+}  // exact_pvalue_impl
+
+template<typename T, isInt<T> = true>
+inline PValueResult exact_pvalue(
+    const T* observed,
+    const T n_row,
+    const T n_col,
+    const Statistic statistic,
+    const size_t max_tables = 1000000,
+    double* factorial_table = nullptr
+) {
+    std::vector<T> n_row_sums;
+    std::vector<T> n_col_sums;
+    const int64_t n_total = observed_marginals<T>(observed, n_row, n_col, n_row_sums, n_col_sums);
+    if (count_tables<T>(n_row, n_col, n_row_sums.data(), n_col_sums.data(), max_tables + 1) > max_tables) {
+        throw InputError("patefield: the number of tables exceeds max_tables.\n");
+    }
+    return exact_pvalue_impl<T>(observed, n_row, n_col, n_row_sums, n_col_sums, n_total, statistic, factorial_table);
+}  // exact_pvalue
+
+template<typename T, isInt<T> = true>
+inline PValueResult adaptive_pvalue(
+    const T* observed,
+    const T n_row,
+    const T n_col,
+    const Statistic statistic,
+    const size_t max_enumerated,
+    const size_t max_tables,
+    const double tolerance,
+    const double confidence = 0.99,
+    const size_t batch_size = 4096,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const Kernel kernel = Kernel::scalar
+) {
+    std::vector<T> n_row_sums;
+    std::vector<T> n_col_sums;
+    const int64_t n_total = observed_marginals<T>(observed, n_row, n_col, n_row_sums, n_col_sums);
+    if (count_tables<T>(n_row, n_col, n_row_sums.data(), n_col_sums.data(), max_enumerated + 1) <= max_enumerated) {
+        return exact_pvalue_impl<T>(
+            observed, n_row, n_col, n_row_sums, n_col_sums, n_total, statistic, factorial_table
+        );
+    }
+    return monte_carlo_pvalue<T>(
+        observed, n_row, n_col, statistic, max_tables, tolerance, confidence, batch_size, n_threads, seed,
+        factorial_table, kernel
+    );
+}  // adaptive_pvalue
+
+}  // namespace details
+
+/* Number of tables with the given marginals, at most `limit`.
+ *
+ *  The tables are counted one by one, the cost is proportional to the
+ *  returned count such that `limit` bounds the time spent on a large support.
+ *
+ * Parameters
+ * ----------
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * limit : the count at which to stop
+ *
+ *  Returns
+ *  -------
+ *  count : the number of tables, `limit` if there are at least `limit` tables
+ */
+size_t count_tables(
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    const size_t limit
+);
+
+/* Number of tables with the given marginals, at most `limit`.
+ *
+ *  See the `int` overload for the description of the arguments.
+ */
+size_t count_tables(
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    const size_t limit
+);
+
+/* All tables with the given marginals and their probability under independence.
+ *
+ *  When there are at most `max_tables` tables every table is listed once with
+ *  its exact probability. Otherwise `n_samples` random tables are drawn as by
+ *  `generate_contingency_tables` with `reproducible = true`, each with weight
+ *  1 / n_samples and `exact` set to false, or an `InputError` is thrown when
+ *  `n_samples` is zero.
+ *
+ * Parameters
+ * ----------
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * max_tables : optional, default = 1000000, the largest number of tables to enumerate
+ * n_samples : optional, default = 0, the number of random tables drawn instead
+ * n_threads : optional, default = 1, the number of threads used to draw the tables
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ *
+ *  Returns
+ *  -------
+ *  distribution : the tables and their probabilities
+ */
+TableDistribution<int> enumerate_contingency_tables(
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    const size_t max_tables = 1000000,
+    const size_t n_samples = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr
+);
+
+/* All tables with the given marginals and their probability under independence.
+ *
+ *  See the `int` overload for the description of the arguments.
+ */
+TableDistribution<int64_t> enumerate_contingency_tables(
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    const size_t max_tables = 1000000,
+    const size_t n_samples = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr
+);
+
+/* Exact p-value of `observed` under independence.
+ *
+ *  The sum of the probabilities of all tables with the marginals of
+ *  `observed` whose statistic is at least that of `observed`. `n_tables` is
+ *  the number of tables with the marginals and `n_extreme` the number of
+ *  those counted.
+ *
+ * Parameters
+ * ----------
+ * observed : the observed table of size [n_row * n_col] in the layout of the
+ *            generators, i.e. cell (i, j) at `observed[i + j * n_row]`,
+ *            all row and column sums must be > 0
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * statistic : the test statistic
+ * max_tables : optional, default = 1000000, an `InputError` is thrown when
+ *              there are more tables with the marginals
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ *
+ *  Returns
+ *  -------
+ *  result : the exact p-value
+ */
+PValueResult exact_pvalue(
+    const int* observed,
+    const int n_row,
+    const int n_col,
+    const Statistic statistic,
+    const size_t max_tables = 1000000,
+    double* factorial_table = nullptr
+);
+
+/* Exact p-value of `observed` under independence.
+ *
+ *  See the `int` overload for the description of the arguments.
+ */
+PValueResult exact_pvalue(
+    const int64_t* observed,
+    const int64_t n_row,
+    const int64_t n_col,
+    const Statistic statistic,
+    const size_t max_tables = 1000000,
+    double* factorial_table = nullptr
+);
+
+/* P-value of `observed` by enumeration when the support is small, otherwise by Monte-Carlo.
+ *
+ *  Computes `exact_pvalue` when there are at most `max_enumerated` tables
+ *  with the marginals of `observed` and `monte_carlo_pvalue` otherwise,
+ *  `exact` of the result tells which.
+ *
+ * Parameters
+ * ----------
+ * max_enumerated : the largest number of tables to enumerate
+ *
+ * See `monte_carlo_pvalue` for the other parameters.
+ *
+ *  Returns
+ *  -------
+ *  result : the p-value, its confidence interval and the number of tables used
+ */
+PValueResult adaptive_pvalue(
+    const int* observed,
+    const int n_row,
+    const int n_col,
+    const Statistic statistic,
+    const size_t max_enumerated,
+    const size_t max_tables,
+    const double tolerance,
+    const double confidence = 0.99,
+    const size_t batch_size = 4096,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const Kernel kernel = Kernel::scalar
+);
+
+/* P-value of `observed` by enumeration when the support is small, otherwise by Monte-Carlo.
+ *
+ *  See the `int` overload for the description of the arguments.
+ */
+PValueResult adaptive_pvalue(
+    const int64_t* observed,
+    const int64_t n_row,
+    const int64_t n_col,
+    const Statistic statistic,
+    const size_t max_enumerated,
+    const size_t max_tables,
+    const double tolerance,
+    const double confidence = 0.99,
+    const size_t batch_size = 4096,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const Kernel kernel = Kernel::scalar
+);
+
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_EXACT_HPP_
@@ -0,0 +1,74 @@
+/* executor.hpp -- Interface for the threads that run the generators.
+ * Copyright 2022 R. Urlus
+ */
+
+#ifndef INCLUDE_PATEFIELD_EXECUTOR_HPP_
+#define INCLUDE_PATEFIELD_EXECUTOR_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+namespace patefield {
+
+/* Executor runs bulk tasks on a set of workers.
+ *
+ *  Derive from it to run the generators on the threads of the host
+ *  application, see `patefield::set_executor`. `ThreadPool` is the
+ *  built-in implementation.
+ */
+class Executor {
+ public:
+    virtual ~Executor() = default;
+
+    /* Number of workers, the upper bound on the `worker` passed to a task. */
+    virtual size_t size() const = 0;
+
+    /* Call `task(i, worker)` for every i in [0, n_tasks) and wait for completion.
+     *
+     *  `worker` must be in [0, size()) and no two tasks may run concurrently
+     *  with the same `worker`. Exceptions thrown by a task should be rethrown.
+     */
+    virtual void run(size_t n_tasks, const std::function<void(size_t, size_t)>& task) = 0;
+
+    /* Number of NUMA nodes the workers are pinned to, see `NumaThreadPool`.
+     *
+     *  When larger than one the generators keep a copy of the factorial
+     *  table on every node.
+     */
+    virtual size_t numa_nodes() const { return 1; }
+};  // Executor
+
+namespace details {
+
+inline std::atomic<Executor*>& executor_slot() {
+    static std::atomic<Executor*> executor{nullptr};
+    return executor;
+}
+
+inline void set_executor(Executor* executor) {
+    executor_slot().store(executor, std::memory_order_release);
+}
+
+inline Executor* get_executor() {
+    return executor_slot().load(std::memory_order_acquire);
+}
+
+}  // namespace details
+
+/* Set the executor that runs the parallel generators.
+ *
+ *  Calls with `n_threads > 1` split their work into `n_threads` tasks that
+ *  are run by `executor`, the number of threads used is that of the
+ *  executor. Without an executor OpenMP is used when the library was built
+ *  with it and the built-in `default_thread_pool()` otherwise.
+ *  The executor must outlive its registration and is not owned.
+ *
+ * Parameters
+ * ----------
+ * executor : the executor, nullptr restores the default
+ */
+void set_executor(Executor* executor);
+
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_EXECUTOR_HPP_
@@ -0,0 +1,212 @@
+/* factorial.hpp -- Log-factorial tables.
+ * Copyright 2022 R. Urlus
+ */
+
+#ifndef INCLUDE_PATEFIELD_FACTORIAL_HPP_
+#define INCLUDE_PATEFIELD_FACTORIAL_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <patefield/commons.hpp>
+
+namespace patefield {
+namespace details {
+
+/* Smallest number of stored log-factorials of the shared table, below
+ * this bound the Stirling series is not accurate to double precision.
+ */
+constexpr int64_t min_stored_factorials = 1024;
+
+/* ln(n!) using the Stirling series, accurate to double precision for n >= 1024. */
+inline double log_factorial_stirling(const int64_t n) {
+    constexpr double half_log_two_pi = 0.91893853320467274178;
+    const double x = static_cast<double>(n);
+    const double inv = 1.0 / x;
+    const double inv2 = inv * inv;
+    return (x + 0.5) * std::log(x) - x + half_log_two_pi
+        + inv * (1.0 / 12.0 - inv2 * (1.0 / 360.0 - inv2 * (1.0 / 1260.0)));
+}
+
+/* Number of log-factorials per chunk of the table.
+ *
+ * The first entry of every chunk but the first is computed using the
+ * Stirling series, the remainder of the chunk is a prefix sum of logs.
+ * The table therefore only depends on the argument, not on the number of
+ * threads used to build it, and chunks can be filled independently.
+ * The chunks start at multiples of 2^16, well above the 1024 from which the
+ * series is accurate to double precision, and it is the series `LogFactorial`
+ * uses beyond the stored arguments. `std::lgamma` is not used as it writes
+ * the global `signgam` on glibc, a data race between the threads.
+ */
+constexpr int64_t factorial_chunk_size = int64_t(1) << 16;
+
+/* Fill `table[first, last]` with log-factorials.
+ *
+ *  When `first` does not start a chunk `table[first - 1]` must be set.
+ *  The chunks are filled in parallel when OpenMP support is enabled.
+ */
+inline void fill_factorial_range(double* table, const int64_t first, const int64_t last) {
+    if (last < first) {
+        return;
+    }
+    const int64_t c_first = first / factorial_chunk_size;
+    const int64_t c_last = last / factorial_chunk_size;
+
+#if defined(PATEFIELD_HAS_OPENMP_SUPPORT)
+    #pragma omp parallel for schedule(static) if (c_last > c_first)
+#endif
+    for (int64_t c = c_first; c <= c_last; c++) {
+        const int64_t lo = std::max(first, c * factorial_chunk_size);
+        const int64_t hi = std::min(last, (c + 1) * factorial_chunk_size - 1);
+
+#if defined(PATEFIELD_HAS_OPENMP_SUPPORT)
+        #pragma omp simd
+#endif
+        for (int64_t i = lo; i <= hi; i++) {
+            table[i] = std::log(static_cast<double>(i));
+        }
+
+        int64_t i = lo;
+        if (lo == 0) {
+            table[0] = 0.0;
+            i = 1;
+        } else if (lo == c * factorial_chunk_size) {
+            table[lo] = log_factorial_stirling(lo);
+            i = lo + 1;
+        }
+        for (; i <= hi; i++) {
+            table[i] += table[i - 1];
+        }
+    }
+}  // fill_factorial_range
+
+template <typename T, isInt<T> = true>
+inline void fill_factorial_table(const T n_total, double* table) {
+    //  Calculate log-factorials.
+    fill_factorial_range(table, 0, static_cast<int64_t>(n_total));
+}  // fill_factorial_table
+
+template <typename T, isInt<T> = true>
+double* create_factorial_table(const T n_total) {
+    auto table = reinterpret_cast<double*>(std::malloc(static_cast<size_t>(n_total + 1) * sizeof(double)));
+    if (!table) throw std::bad_alloc();
+    fill_factorial_table<T>(n_total, table);
+    return table;
+}  // create_factorial_table
+
+/* Read-only view on log-factorials.
+ *
+ *  Arguments up to `n_stored` are looked up in the table, larger arguments
+ *  are computed using the Stirling series. The view keeps a shared table
+ *  alive so it can be used after the shared table has been regrown.
+ */
+class LogFactorial {
+    std::shared_ptr<const std::vector<double>> owner_;
+    const double* data_ = nullptr;
+    int64_t n_stored_ = -1;
+
+ public:
+    LogFactorial() = default;
+
+    /* View on an external table of size [n_stored + 1], not owned. */
+    LogFactorial(const double* table, const int64_t n_stored) : data_{table}, n_stored_{n_stored} {}
+
+    explicit LogFactorial(std::shared_ptr<const std::vector<double>> table) :
+        owner_{std::move(table)},
+        data_{owner_->data()},
+        n_stored_{static_cast<int64_t>(owner_->size()) - 1} {}
+
+    inline double operator[](const int64_t n) const {
+        return n <= n_stored_ ? data_[n] : log_factorial_stirling(n);
+    }
+
+    /* True if all arguments in [0, n_total] are stored in the table. */
+    bool is_dense(const int64_t n_total) const { return n_total <= n_stored_; }
+    const double* data() const { return data_; }
+    int64_t n_stored() const { return n_stored_; }
+};  // LogFactorial
+
+/* State of the process-wide log-factorial table. */
+struct SharedFactorialState {
+    std::mutex mutex;
+    std::shared_ptr<const std::vector<double>> table;
+    // copies of `table` per NUMA node, see `NodeTables`, dropped when the table is replaced
+    std::vector<std::shared_ptr<const double>> node_replicas;
+    // largest argument stored in the table, beyond it the Stirling series is used
+    int64_t max_stored = (int64_t(1) << 24) - 1;
+};
+
+inline SharedFactorialState& shared_factorial_state() {
+    static SharedFactorialState state;
+    return state;
+}
+
+/* Log-factorials for [0, n_total] from the process-wide table.
+ *
+ *  The table is grown on demand, at least doubling in size, up to
+ *  `max_stored` arguments. Only the new range is filled, the values are
+ *  identical to those of `create_factorial_table`.
+ *  The returned view is safe to share between threads.
+ */
+inline LogFactorial shared_log_factorials(const int64_t n_total) {
+    SharedFactorialState& state = shared_factorial_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    const int64_t n_stored = state.table ? static_cast<int64_t>(state.table->size()) - 1 : -1;
+    if (n_total > n_stored && n_stored < state.max_stored) {
+        const int64_t target = std::min(std::max(n_total, 2 * (n_stored + 1)), state.max_stored);
+        auto table = std::make_shared<std::vector<double>>(static_cast<size_t>(target + 1));
+        if (n_stored >= 0) {
+            std::copy(state.table->begin(), state.table->end(), table->begin());
+        }
+        fill_factorial_range(table->data(), n_stored + 1, target);
+        state.table = std::move(table);
+        state.node_replicas.clear();
+    }
+    return LogFactorial(state.table);
+}  // shared_log_factorials
+
+/* Set the largest argument stored by the process-wide table, at least `min_stored_factorials - 1`. */
+inline void set_max_stored_factorials(const int64_t n_max) {
+    SharedFactorialState& state = shared_factorial_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.max_stored = std::max(n_max, min_stored_factorials - 1);
+}
+
+/* Release the process-wide table, views that are still alive keep their table. */
+inline void release_shared_factorials() {
+    SharedFactorialState& state = shared_factorial_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.table.reset();
+    state.node_replicas.clear();
+}
+
+/* Call `func` with `factorial_table` or, when it is null, the process-wide table.
+ *
+ *  `func` receives a `const double*` when all arguments in [0, n_total] are
+ *  stored and a `LogFactorial` view otherwise.
+ */
+template<typename Func>
+inline void with_factorial_table(const double* factorial_table, const int64_t n_total, Func&& func) {
+    if (factorial_table) {
+        func(factorial_table);
+        return;
+    }
+    const LogFactorial shared = shared_log_factorials(n_total);
+    if (shared.is_dense(n_total)) {
+        func(shared.data());
+    } else {
+        func(shared);
+    }
+}  // with_factorial_table
+
+}  // namespace details
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_FACTORIAL_HPP_
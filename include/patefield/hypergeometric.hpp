@@ -0,0 +1,171 @@
+/* hypergeometric.hpp -- Rejection sampler for the cells of large tables.
+ * Copyright 2022 R. Urlus
+ *
+ * The walk from the mode in `rcont2` costs O(sqrt(variance)) per cell
+ * which dominates for tables with large totals. The HRUA algorithm,
+ * ratio-of-uniforms rejection, draws from the hypergeometric
+ * distribution at a cost that is roughly constant in its parameters.
+ *
+ * Reference:
+ *
+ *   E. Stadlober,
+ *   Sampling from Poisson, binomial and hypergeometric distributions:
+ *   ratio of uniforms as a simple and fast alternative,
+ *   Bericht 303, Math. Stat. Sektion, Forschungsgesellschaft Joanneum, Graz, 1989.
+ *
+ * The implementation follows the one in NumPy.
+ */
+
+#ifndef INCLUDE_PATEFIELD_HYPERGEOMETRIC_HPP_
+#define INCLUDE_PATEFIELD_HYPERGEOMETRIC_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+#include <patefield/commons.hpp>
+#include <patefield/rcont.hpp>
+#include <patefield/stats.hpp>
+#include <patefield/uniform.hpp>
+
+namespace patefield {
+namespace details {
+
+/* Draw from the hypergeometric distribution using HRUA.
+ *
+ * Parameters
+ * ----------
+ * good : number of success states in the population
+ * bad : number of failure states in the population
+ * sample : number of draws, must be in [10, good + bad - 10]
+ * factorial_table : pointer to table containing the log factorials,
+ *                   of at least size [good + bad + 1], or a `LogFactorial` view
+ * rng : instantiated random number generator of PCG RNG family
+ * uni_dist : uniform over the open set (0, 1), see `OpenUniform`
+ *
+ *  Returns
+ *  -------
+ *  value : the number of successes
+ */
+template<typename Table, typename Uniform>
+inline int64_t hypergeometric_hrua(
+    const int64_t good,
+    const int64_t bad,
+    const int64_t sample,
+    const Table& factorial_table,
+    pcg64_dxsm& rng,
+    Uniform& uni_dist
+) {
+    constexpr double D1 = 1.7155277699214135;
+    constexpr double D2 = 0.8989161620588988;
+
+    const int64_t popsize = good + bad;
+    const int64_t computed_sample = std::min(sample, popsize - sample);
+    const int64_t mingoodbad = std::min(good, bad);
+    const int64_t maxgoodbad = std::max(good, bad);
+
+    const double p = static_cast<double>(mingoodbad) / static_cast<double>(popsize);
+    const double q = static_cast<double>(maxgoodbad) / static_cast<double>(popsize);
+
+    // mean and variance of the distribution
+    const double mu = static_cast<double>(computed_sample) * p;
+    const double var = static_cast<double>(popsize - computed_sample) * static_cast<double>(computed_sample) * p * q
+        / static_cast<double>(popsize - 1);
+
+    const double a = mu + 0.5;
+    const double c = std::sqrt(var + 0.5);
+    const double h = D1 * c + D2;
+
+    const int64_t m = static_cast<int64_t>(std::floor(
+        static_cast<double>(computed_sample + 1) * static_cast<double>(mingoodbad + 1)
+        / static_cast<double>(popsize + 2)));
+
+    const double g = factorial_table[m] + factorial_table[mingoodbad - m] + factorial_table[computed_sample - m]
+        + factorial_table[maxgoodbad - computed_sample + m];
+
+    const double b = std::min(
+        static_cast<double>(std::min(computed_sample, mingoodbad) + 1), std::floor(a + 16.0 * c)
+    );
+
+    int64_t k;
+    for (;;) {
+        const double u = uni_dist(rng);
+        const double v = uni_dist(rng);
+        count_stat(Stat::rng_draws, 2);
+        const double x = a + h * (v - 0.5) / u;
+
+        // fast rejection
+        if ((x < 0.0) || (x >= b)) {
+            continue;
+        }
+
+        k = static_cast<int64_t>(std::floor(x));
+
+        const double gp = factorial_table[k] + factorial_table[mingoodbad - k] + factorial_table[computed_sample - k]
+            + factorial_table[maxgoodbad - computed_sample + k];
+        const double t = g - gp;
+
+        // fast acceptance
+        if ((u * (4.0 - u) - 3.0) <= t) {
+            break;
+        }
+
+        // fast rejection
+        if (u * (u - t) >= 1.0) {
+            continue;
+        }
+
+        // acceptance
+        if (2.0 * std::log(u) <= t) {
+            break;
+        }
+    }
+
+    if (good > bad) {
+        k = computed_sample - k;
+    }
+    if (computed_sample < sample) {
+        k = good - k;
+    }
+    return k;
+}  // hypergeometric_hrua
+
+/* Hrua draws the entry of a cell using HRUA rejection for large cells.
+ *
+ *   Cell strategy for `rcont2`, cells whose conditional distribution
+ *   has a standard deviation below `min_stddev` are drawn using `ModeWalk`
+ *   as the walk is cheaper for narrow distributions.
+ */
+struct Hrua {
+    double min_stddev = 8.0;
+    ModeWalk walk;
+    OpenUniform uni_dist;
+
+    Hrua() = default;
+    explicit Hrua(const double min_stddev) : min_stddev{min_stddev} {}
+
+    template<typename T, typename Table, isInt<T> = true>
+    inline T draw(const T ia, const T id, const T ie, const Table& factorial_table, pcg64_dxsm& rng) {
+        // the cell counts how many of the `ia` draws from the remaining
+        // total `ie` fall in the column with remaining sum `id`
+        const int64_t good = id;
+        const int64_t bad = static_cast<int64_t>(ie) - id;
+        const int64_t sample = ia;
+        if (sample < 10 || sample > (good + bad - 10)) {
+            return walk.template draw<T>(ia, id, ie, factorial_table, rng);
+        }
+        const double popsize = static_cast<double>(ie);
+        const double var = static_cast<double>(sample) * (static_cast<double>(good) / popsize)
+            * (static_cast<double>(bad) / popsize) * (popsize - static_cast<double>(sample)) / (popsize - 1.0);
+        if (var < min_stddev * min_stddev) {
+            return walk.template draw<T>(ia, id, ie, factorial_table, rng);
+        }
+        return static_cast<T>(hypergeometric_hrua(good, bad, sample, factorial_table, rng, uni_dist));
+    }
+};  // Hrua
+
+}  // namespace details
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_HYPERGEOMETRIC_HPP_
@@ -0,0 +1,194 @@
+/* jobs.hpp -- Generate tables for a batch of independent jobs.
+ * Copyright 2022 R. Urlus
+ *
+ * Running many small problems one at a time leaves most cores idle at the
+ * end of every problem and rebuilds or regrows the factorial table for each.
+ * The jobs below are split into chunks that are balanced over the workers of
+ * a persistent `ThreadPool`, all jobs share one factorial table sized to the
+ * largest `n_total`.
+ */
+
+#ifndef INCLUDE_PATEFIELD_JOBS_HPP_
+#define INCLUDE_PATEFIELD_JOBS_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include <patefield/commons.hpp>
+#include <patefield/executor.hpp>
+#include <patefield/factorial.hpp>
+#include <patefield/patefield.hpp>
+#include <patefield/thread_pool.hpp>
+
+namespace patefield {
+
+/* A set of tables with the same marginals.
+ *
+ * n_tables : number of tables to generate
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * seed : a seed for the random number generator, 0 is drawn as described by
+ *        `generate_contingency_tables`
+ * result : pointer to the memory where the tables will be stored, must be of
+ *          size [n_tables * n_row * n_col], allocated with `std::malloc` when null
+ * n_total : the sum of the column or row sums, computed when 0
+ */
+template<typename T, isInt<T> = true>
+struct TableJob {
+    size_t n_tables = 0;
+    T n_row = 0;
+    T n_col = 0;
+    const T* n_row_sums = nullptr;
+    const T* n_col_sums = nullptr;
+    uint64_t seed = 0;
+    T* result = nullptr;
+    int64_t n_total = 0;
+};
+
+namespace details {
+
+template<typename T, isInt<T> = true>
+inline void generate_jobs(
+    TableJob<T>* jobs,
+    const size_t n_jobs,
+    Executor& executor,
+    const size_t chunk_size = 256,
+    double* factorial_table = nullptr,
+    const Kernel kernel = Kernel::scalar
+) {
+    // tables [first, first + n_tables) of a job
+    struct Chunk {
+        size_t job;
+        size_t first;
+        size_t n_tables;
+    };
+
+    if (chunk_size == 0) {
+        throw InputError("patefield: chunk_size must be positive.\n");
+    }
+    std::vector<uint64_t> base_seeds(n_jobs);
+    int64_t max_total = 0;
+    size_t max_col = 0;
+    size_t n_chunks = 0;
+    for (size_t j = 0; j < n_jobs; j++) {
+        TableJob<T>& job = jobs[j];
+        if (job.n_total == 0) {
+            job.n_total = check_inputs<T>(job.n_row, job.n_col, job.n_row_sums, job.n_col_sums);
+        }
+        base_seeds[j] = resolve_seed(job.seed);
+        max_total = std::max(max_total, job.n_total);
+        max_col = std::max(max_col, static_cast<size_t>(job.n_col));
+        n_chunks += (job.n_tables + chunk_size - 1) / chunk_size;
+    }
+    for (size_t j = 0; j < n_jobs; j++) {
+        TableJob<T>& job = jobs[j];
+        if (!job.result) {
+            const size_t block_size = static_cast<size_t>(job.n_row) * static_cast<size_t>(job.n_col);
+            job.result = reinterpret_cast<T*>(std::malloc(block_size * sizeof(T) * job.n_tables));
+            if (!job.result) throw std::bad_alloc();
+        }
+    }
+
+    // chunks of a job are adjacent, a worker mostly stays on the marginals of one job
+    std::vector<Chunk> chunks;
+    chunks.reserve(n_chunks);
+    for (size_t j = 0; j < n_jobs; j++) {
+        for (size_t first = 0; first < jobs[j].n_tables; first += chunk_size) {
+            chunks.push_back({j, first, std::min(chunk_size, jobs[j].n_tables - first)});
+        }
+    }
+
+    std::vector<std::unique_ptr<int64_t[]>> jworks(executor.size());
+    for (auto& jwork : jworks) {
+        jwork.reset(new int64_t[simd_lanes * std::max<size_t>(max_col, 1)]);
+    }
+
+    with_factorial_table(factorial_table, max_total, [&](const auto& table) {
+        executor.run(chunks.size(), [&](const size_t c, const size_t worker) {
+            const Chunk& chunk = chunks[c];
+            const TableJob<T>& job = jobs[chunk.job];
+            const size_t block_size = static_cast<size_t>(job.n_row) * static_cast<size_t>(job.n_col);
+            generate_table_range<T>(
+                chunk.first, chunk.n_tables, job.n_row, job.n_col, job.n_row_sums, job.n_col_sums, job.n_total,
+                base_seeds[chunk.job], table, job.result + chunk.first * block_size, kernel, jworks[worker].get()
+            );
+        });
+    });
+}  // generate_jobs
+
+}  // namespace details
+
+/* Generate the tables of `n_jobs` jobs on `executor`.
+ *
+ *  The jobs are split into chunks of at most `chunk_size` tables which are
+ *  balanced over the workers of the executor, on a `ThreadPool` idle workers
+ *  steal chunks from busy ones. All jobs share a single factorial table for
+ *  the largest `n_total`.
+ *  Table `i` of a job is drawn from its own stream derived from the seed of
+ *  the job and `i`, the tables of a job are identical to those of
+ *  `generate_contingency_tables` with `reproducible = true`, independent of
+ *  the number of workers and the other jobs.
+ *
+ * Parameters
+ * ----------
+ * jobs : the jobs, `n_total` and `result` are set when they are not provided
+ * n_jobs : number of jobs
+ * executor : the workers, e.g. `patefield::default_thread_pool()`
+ * chunk_size : optional, default = 256, the maximum number of tables per task
+ * factorial_table : optional, pointer to table containing the log factorials
+ *                   of at least the largest `n_total`, can be created using
+ *                   `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables
+ */
+void generate_jobs(
+    TableJob<int>* jobs,
+    const size_t n_jobs,
+    Executor& executor,
+    const size_t chunk_size = 256,
+    double* factorial_table = nullptr,
+    const Kernel kernel = Kernel::scalar
+);
+
+/* Generate the tables of `n_jobs` jobs on `executor`.
+ *
+ *  The jobs are split into chunks of at most `chunk_size` tables which are
+ *  balanced over the workers of the executor, on a `ThreadPool` idle workers
+ *  steal chunks from busy ones. All jobs share a single factorial table for
+ *  the largest `n_total`.
+ *  Table `i` of a job is drawn from its own stream derived from the seed of
+ *  the job and `i`, the tables of a job are identical to those of
+ *  `generate_contingency_tables` with `reproducible = true`, independent of
+ *  the number of workers and the other jobs.
+ *
+ * Parameters
+ * ----------
+ * jobs : the jobs, `n_total` and `result` are set when they are not provided
+ * n_jobs : number of jobs
+ * executor : the workers, e.g. `patefield::default_thread_pool()`
+ * chunk_size : optional, default = 256, the maximum number of tables per task
+ * factorial_table : optional, pointer to table containing the log factorials
+ *                   of at least the largest `n_total`, can be created using
+ *                   `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables
+ */
+void generate_jobs(
+    TableJob<int64_t>* jobs,
+    const size_t n_jobs,
+    Executor& executor,
+    const size_t chunk_size = 256,
+    double* factorial_table = nullptr,
+    const Kernel kernel = Kernel::scalar
+);
+
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_JOBS_HPP_
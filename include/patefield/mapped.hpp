@@ -0,0 +1,476 @@
+/* mapped.hpp -- Generate tables into memory-mapped files.
+ * Copyright 2022 R. Urlus
+ *
+ * A table file starts with a `TableFileHeader`, followed by the row and
+ * column sums as int64 and, at `data_offset` which is page aligned, the
+ * tables exactly as the batch generators store them in `result`. The
+ * generators write straight into the mapping, `TableFile` maps an existing
+ * file read-only such that the tables are paged in on first access.
+ * The header is in native byte order.
+ * Requires POSIX memory mapping, `PATEFIELD_HAS_MMAP_SUPPORT` is set by the
+ * build on Unix-like systems.
+ */
+
+#ifndef INCLUDE_PATEFIELD_MAPPED_HPP_
+#define INCLUDE_PATEFIELD_MAPPED_HPP_
+
+#if defined(PATEFIELD_HAS_MMAP_SUPPORT)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <patefield/commons.hpp>
+#include <patefield/patefield.hpp>
+
+namespace patefield {
+
+/* Type of the cells stored in a table file. */
+enum class ElementType : uint32_t { int32 = 0, int64 = 1, uint8 = 2, uint16 = 3, uint32 = 4 };
+
+/* Header of a table file.
+ *
+ * magic : "PATEFLD" followed by a zero byte
+ * version : version of the format, currently 1
+ * element_type : type of the cells
+ * element_size : size of a cell in bytes
+ * layout : the `Layout` of the tables
+ * kernel : the `Kernel` used to generate the tables
+ * reproducible : 1 if the tables were generated with per-table streams
+ * n_tables : number of tables
+ * n_row : number of rows of a table
+ * n_col : number of columns of a table
+ * seed : the seed used, also when it was drawn because 0 was passed
+ * data_offset : offset in bytes of the first table
+ */
+struct TableFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t element_type;
+    uint32_t element_size;
+    uint32_t layout;
+    uint32_t kernel;
+    uint32_t reproducible;
+    uint64_t n_tables;
+    int64_t n_row;
+    int64_t n_col;
+    uint64_t seed;
+    uint64_t data_offset;
+};
+
+namespace details {
+
+constexpr char table_file_magic[8] = {'P', 'A', 'T', 'E', 'F', 'L', 'D', '\0'};
+constexpr uint32_t table_file_version = 1;
+constexpr uint64_t table_file_alignment = 4096;
+
+template<typename S>
+constexpr ElementType element_type_of() {
+    static_assert(std::is_integral<S>::value, "cells must be integers");
+    static_assert(
+        std::is_unsigned<S>::value ? sizeof(S) <= 4 : sizeof(S) == 4 || sizeof(S) == 8,
+        "cells must be int32, int64, uint8, uint16 or uint32"
+    );
+    return std::is_same<S, uint8_t>::value ? ElementType::uint8
+        : std::is_same<S, uint16_t>::value ? ElementType::uint16
+        : std::is_same<S, uint32_t>::value ? ElementType::uint32
+        : sizeof(S) == 8 ? ElementType::int64 : ElementType::int32;
+}
+
+/* `a * b` in `result`, false when it overflows. */
+inline bool checked_multiply(const uint64_t a, const uint64_t b, uint64_t& result) {
+    if (a != 0 && b > std::numeric_limits<uint64_t>::max() / a) {
+        return false;
+    }
+    result = a * b;
+    return true;
+}
+
+/* `a + b` in `result`, false when it overflows. */
+inline bool checked_add(const uint64_t a, const uint64_t b, uint64_t& result) {
+    if (b > std::numeric_limits<uint64_t>::max() - a) {
+        return false;
+    }
+    result = a + b;
+    return true;
+}
+
+/* Size in bytes of the element type, 0 when the type is unknown. */
+inline uint32_t element_type_size(const uint32_t element_type) {
+    switch (static_cast<ElementType>(element_type)) {
+        case ElementType::int32: return 4;
+        case ElementType::int64: return 8;
+        case ElementType::uint8: return 1;
+        case ElementType::uint16: return 2;
+        case ElementType::uint32: return 4;
+        default: return 0;
+    }
+}
+
+/* Check that the regions described by `header` lie within a file of `file_size` bytes.
+ *
+ *  The header is read from the file and is not trusted: every size is
+ *  computed with overflow checks, the marginals must end before the tables
+ *  and the tables before the end of the file.
+ */
+inline void check_table_file_header(const TableFileHeader& header, const uint64_t file_size) {
+    if (header.n_row < 2 || header.n_col < 2) {
+        throw InputError("patefield: table file has less than 2 rows or columns.\n");
+    }
+    const uint32_t element_size = element_type_size(header.element_type);
+    if (element_size == 0 || header.element_size != element_size) {
+        throw InputError("patefield: table file has an invalid element type.\n");
+    }
+    if (header.layout > static_cast<uint32_t>(Layout::cell_major)) {
+        throw InputError("patefield: table file has an invalid layout.\n");
+    }
+    const uint64_t n_row = static_cast<uint64_t>(header.n_row);
+    const uint64_t n_col = static_cast<uint64_t>(header.n_col);
+    uint64_t n_marginals;
+    uint64_t marginals_end;
+    uint64_t block_size;
+    uint64_t data_size;
+    uint64_t data_end;
+    if (!checked_add(n_row, n_col, n_marginals)
+        || !checked_multiply(n_marginals, sizeof(int64_t), marginals_end)
+        || !checked_add(marginals_end, sizeof(TableFileHeader), marginals_end)
+        || !checked_multiply(n_row, n_col, block_size)
+        || !checked_multiply(block_size, element_size, block_size)
+        || !checked_multiply(block_size, header.n_tables, data_size)
+        || !checked_add(header.data_offset, data_size, data_end)) {
+        throw InputError("patefield: table file has an invalid size.\n");
+    }
+    if (header.data_offset < marginals_end || header.data_offset % element_size != 0) {
+        throw InputError("patefield: table file has an invalid data offset.\n");
+    }
+    if (file_size < data_end) {
+        throw InputError("patefield: table file is truncated.\n");
+    }
+}  // check_table_file_header
+
+[[noreturn]] inline void throw_file_error(const int error, const std::string& what, const std::string& path) {
+    throw std::system_error(error, std::generic_category(), "patefield: " + what + " `" + path + "`");
+}
+
+/* Owner of a file descriptor and its mapping. */
+class FileMapping {
+    int fd_ = -1;
+    void* addr_ = nullptr;
+    size_t size_ = 0;
+
+ public:
+    FileMapping() = default;
+    FileMapping(const std::string& path, const size_t size, const bool writable) : size_{size} {
+        fd_ = writable ? ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644) : ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            throw_file_error(errno, "could not open", path);
+        }
+        if (writable) {
+            if (::ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+                const int error = errno;
+                ::close(fd_);
+                throw_file_error(error, "could not resize", path);
+            }
+        } else {
+            struct stat info;
+            if (::fstat(fd_, &info) != 0) {
+                const int error = errno;
+                ::close(fd_);
+                throw_file_error(error, "could not stat", path);
+            }
+            size_ = static_cast<size_t>(info.st_size);
+        }
+        if (size_ < sizeof(TableFileHeader)) {
+            ::close(fd_);
+            throw InputError("patefield: file is too small to be a table file.\n");
+        }
+        const int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+        addr_ = ::mmap(nullptr, size_, prot, MAP_SHARED, fd_, 0);
+        if (addr_ == MAP_FAILED) {
+            const int error = errno;
+            addr_ = nullptr;
+            ::close(fd_);
+            throw_file_error(error, "could not map", path);
+        }
+    }
+
+    FileMapping(FileMapping&& other) noexcept :
+        fd_{std::exchange(other.fd_, -1)},
+        addr_{std::exchange(other.addr_, nullptr)},
+        size_{std::exchange(other.size_, 0)} {}
+
+    FileMapping& operator=(FileMapping&& other) noexcept {
+        if (this != &other) {
+            release();
+            fd_ = std::exchange(other.fd_, -1);
+            addr_ = std::exchange(other.addr_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+
+    ~FileMapping() { release(); }
+
+    void release() {
+        if (addr_) {
+            ::munmap(addr_, size_);
+            addr_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    char* data() const { return static_cast<char*>(addr_); }
+    size_t size() const { return size_; }
+};  // FileMapping
+
+template<typename T, typename S = T, isInt<T> = true>
+inline TableFileHeader generate_tables_to_file(
+    const std::string& path,
+    const size_t n_tables,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const bool reproducible = false,
+    const Kernel kernel = Kernel::scalar,
+    const Layout layout = Layout::column_major
+) {
+    if (n_total == 0) {
+        n_total = check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums);
+    }
+    if (!std::is_same<S, T>::value) {
+        check_storage<S>(n_row, n_col, n_row_sums, n_col_sums);
+    }
+    const size_t marginals_size = (static_cast<size_t>(n_row) + static_cast<size_t>(n_col)) * sizeof(int64_t);
+    const uint64_t data_offset = ((sizeof(TableFileHeader) + marginals_size + table_file_alignment - 1)
+        / table_file_alignment) * table_file_alignment;
+    const size_t data_size = n_tables * static_cast<size_t>(n_row) * static_cast<size_t>(n_col) * sizeof(S);
+
+    TableFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.version = table_file_version;
+    header.element_type = static_cast<uint32_t>(element_type_of<S>());
+    header.element_size = sizeof(S);
+    header.layout = static_cast<uint32_t>(layout);
+    header.kernel = static_cast<uint32_t>(kernel);
+    header.reproducible = reproducible ? 1 : 0;
+    header.n_tables = n_tables;
+    header.n_row = static_cast<int64_t>(n_row);
+    header.n_col = static_cast<int64_t>(n_col);
+    // record the seed that is actually used
+    header.seed = resolve_seed(seed);
+    header.data_offset = data_offset;
+
+    FileMapping mapping(path, data_offset + data_size, true);
+    char* base = mapping.data();
+    int64_t* marginals = reinterpret_cast<int64_t*>(base + sizeof(TableFileHeader));
+    for (T i = 0; i < n_row; i++) {
+        marginals[i] = static_cast<int64_t>(n_row_sums[i]);
+    }
+    for (T j = 0; j < n_col; j++) {
+        marginals[n_row + j] = static_cast<int64_t>(n_col_sums[j]);
+    }
+    if (n_tables > 0) {
+        generate_contingency_tables<T, S>(
+            n_tables, n_row, n_col, n_row_sums, n_col_sums, n_total, n_threads, header.seed, factorial_table,
+            reinterpret_cast<S*>(base + data_offset), reproducible, kernel, layout
+        );
+    }
+    // the magic is written last, an interrupted file is not a valid table file
+    std::memcpy(header.magic, table_file_magic, sizeof(header.magic));
+    std::memcpy(base, &header, sizeof(header));
+    return header;
+}  // generate_tables_to_file
+
+}  // namespace details
+
+/* TableFile maps a table file read-only.
+ *
+ *  The tables are paged in when they are accessed, nothing is copied.
+ *
+ * Parameters
+ * ----------
+ * path : the table file, e.g. written by `generate_contingency_tables_to_file`
+ */
+class TableFile {
+    details::FileMapping mapping_;
+    TableFileHeader header_;
+
+    template<typename S>
+    void check_type() const {
+        if (header_.element_type != static_cast<uint32_t>(details::element_type_of<S>())
+            || header_.element_size != sizeof(S)) {
+            throw InputError("patefield: element type does not match that of the file.\n");
+        }
+    }
+
+ public:
+    explicit TableFile(const std::string& path) : mapping_{path, 0, false} {
+        std::memcpy(&header_, mapping_.data(), sizeof(header_));
+        if (std::memcmp(header_.magic, details::table_file_magic, sizeof(header_.magic)) != 0) {
+            throw InputError("patefield: not a table file or the file is incomplete.\n");
+        }
+        if (header_.version != details::table_file_version) {
+            throw InputError("patefield: unsupported version of the table file.\n");
+        }
+        details::check_table_file_header(header_, static_cast<uint64_t>(mapping_.size()));
+    }
+
+    const TableFileHeader& header() const { return header_; }
+    size_t n_tables() const { return static_cast<size_t>(header_.n_tables); }
+    int64_t n_row() const { return header_.n_row; }
+    int64_t n_col() const { return header_.n_col; }
+    Layout layout() const { return static_cast<Layout>(header_.layout); }
+    ElementType element_type() const { return static_cast<ElementType>(header_.element_type); }
+    uint64_t seed() const { return header_.seed; }
+
+    /* The row sums, of size [n_row]. */
+    const int64_t* row_sums() const {
+        return reinterpret_cast<const int64_t*>(mapping_.data() + sizeof(TableFileHeader));
+    }
+
+    /* The column sums, of size [n_col]. */
+    const int64_t* col_sums() const { return row_sums() + header_.n_row; }
+
+    /* All tables stored using `layout()`, `S` must match `element_type()`. */
+    template<typename S>
+    const S* data() const {
+        check_type<S>();
+        return reinterpret_cast<const S*>(mapping_.data() + header_.data_offset);
+    }
+
+    /* Table `index`, not available for `Layout::cell_major`. */
+    template<typename S>
+    const S* table(const size_t index) const {
+        if (layout() == Layout::cell_major) {
+            throw InputError("patefield: tables of a cell-major file are not contiguous.\n");
+        }
+        if (index >= n_tables()) {
+            throw InputError("patefield: table index out of range.\n");
+        }
+        return data<S>() + index * static_cast<size_t>(header_.n_row) * static_cast<size_t>(header_.n_col);
+    }
+};  // TableFile
+
+/* Generate `n_tables` random two-way contingency tables into a memory-mapped file.
+ *
+ *  The tables are written directly into the mapping of `path`, which is
+ *  created or truncated, using the format described by `TableFileHeader`.
+ *  Read the file using `TableFile`.
+ *
+ * Parameters
+ * ----------
+ * path : the file to write
+ * n_tables : number of tables to generate
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * n_total : optional, default = 0, the sum of the column or row sums
+ * n_threads : optional, default = 1, the number of threads used to generate
+ *             the tables
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`,
+ *        the seed used is stored in the header.
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ * reproducible : optional, default = false, draw table `i` from its own
+ *                random stream derived from `seed` and `i` such that the
+ *                tables do not depend on `n_threads`.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables
+ * layout : optional, default = Layout::column_major, the memory layout of the tables
+ *
+ *  Returns
+ *  -------
+ *  header : the header written to the file
+ */
+TableFileHeader generate_contingency_tables_to_file(
+    const std::string& path,
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const bool reproducible = false,
+    const Kernel kernel = Kernel::scalar,
+    const Layout layout = Layout::column_major
+);
+
+/* Generate `n_tables` random two-way contingency tables into a memory-mapped file.
+ *
+ *  The tables are written directly into the mapping of `path`, which is
+ *  created or truncated, using the format described by `TableFileHeader`.
+ *  Read the file using `TableFile`.
+ *
+ * Parameters
+ * ----------
+ * path : the file to write
+ * n_tables : number of tables to generate
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * n_total : optional, default = 0, the sum of the column or row sums
+ * n_threads : optional, default = 1, the number of threads used to generate
+ *             the tables
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`,
+ *        the seed used is stored in the header.
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ * reproducible : optional, default = false, draw table `i` from its own
+ *                random stream derived from `seed` and `i` such that the
+ *                tables do not depend on `n_threads`.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables
+ * layout : optional, default = Layout::column_major, the memory layout of the tables
+ *
+ *  Returns
+ *  -------
+ *  header : the header written to the file
+ */
+TableFileHeader generate_contingency_tables_to_file(
+    const std::string& path,
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const bool reproducible = false,
+    const Kernel kernel = Kernel::scalar,
+    const Layout layout = Layout::column_major
+);
+
+}  // namespace patefield
+#endif  // PATEFIELD_HAS_MMAP_SUPPORT
+#endif  // INCLUDE_PATEFIELD_MAPPED_HPP_
@@ -0,0 +1,328 @@
+/* mpi.hpp -- Generate one ensemble of tables on the ranks of an MPI communicator.
+ * Copyright 2022 R. Urlus
+ *
+ * The tables [0, n_tables) are split in contiguous ranges over the ranks,
+ * table `i` is drawn from the stream given by the seed and `i` on whichever
+ * rank holds it. The union of the ranges is therefore identical to the
+ * tables of `generate_contingency_tables` with `reproducible = true` on a
+ * single node, independent of the number of ranks and threads.
+ * Requires the library to be built with `PATEFIELD_ENABLE_MPI`.
+ */
+
+#ifndef INCLUDE_PATEFIELD_MPI_HPP_
+#define INCLUDE_PATEFIELD_MPI_HPP_
+
+#if defined(PATEFIELD_HAS_MPI_SUPPORT)
+#include <mpi.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+#include <patefield/commons.hpp>
+#include <patefield/factorial.hpp>
+#include <patefield/parallel.hpp>
+#include <patefield/patefield.hpp>
+#include <patefield/statistics.hpp>
+
+namespace patefield {
+
+/* The tables [first, first + n_tables) of a rank. */
+struct RankRange {
+    size_t first = 0;
+    size_t n_tables = 0;
+};
+
+namespace details {
+
+/* Range of `rank` out of `n_ranks`, the first `n_tables % n_ranks` ranks hold one table more. */
+inline RankRange rank_range(const size_t n_tables, const size_t rank, const size_t n_ranks) {
+    const size_t base = n_tables / n_ranks;
+    const size_t extra = n_tables % n_ranks;
+    RankRange range;
+    range.first = rank * base + std::min(rank, extra);
+    range.n_tables = base + (rank < extra ? 1 : 0);
+    return range;
+}  // rank_range
+
+inline RankRange mpi_rank_range(MPI_Comm comm, const size_t n_tables) {
+    int rank = 0;
+    int n_ranks = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &n_ranks);
+    return rank_range(n_tables, static_cast<size_t>(rank), static_cast<size_t>(n_ranks));
+}  // mpi_rank_range
+
+/* The seed of rank 0 on all ranks, drawn on rank 0 when it is 0. */
+inline uint64_t mpi_shared_seed(MPI_Comm comm, const uint64_t seed) {
+    int rank = 0;
+    MPI_Comm_rank(comm, &rank);
+    uint64_t shared = rank == 0 ? resolve_seed(seed) : 0;
+    MPI_Bcast(&shared, 1, MPI_UINT64_T, 0, comm);
+    return shared;
+}  // mpi_shared_seed
+
+template<typename T, isInt<T> = true>
+inline T* generate_contingency_tables_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    T* result = nullptr,
+    const Kernel kernel = Kernel::scalar
+) {
+    if (n_total == 0) {
+        n_total = check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums);
+    }
+    const uint64_t base_seed = mpi_shared_seed(comm, seed);
+    const RankRange range = mpi_rank_range(comm, n_tables);
+    const size_t block_size = static_cast<size_t>(n_row) * static_cast<size_t>(n_col);
+    if (!result) {
+        result = reinterpret_cast<T*>(std::malloc(std::max<size_t>(range.n_tables * block_size, 1) * sizeof(T)));
+        if (!result) throw std::bad_alloc();
+    }
+    with_factorial_table(factorial_table, n_total, [&](const auto& table) {
+        parallel_blocks(n_threads, range.n_tables, [&](const size_t, const size_t begin, const size_t end) {
+            std::unique_ptr<int64_t[]> jwork(new int64_t[simd_lanes * static_cast<size_t>(n_col)]);
+            generate_table_range<T>(
+                range.first + begin, end - begin, n_row, n_col, n_row_sums, n_col_sums, n_total, base_seed, table,
+                result + begin * block_size, kernel, jwork.get()
+            );
+        });
+    });
+    return result;
+}  // generate_contingency_tables_mpi
+
+template<typename T, isInt<T> = true>
+inline double* generate_statistics_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    double* result = nullptr,
+    const Kernel kernel = Kernel::scalar
+) {
+    if (n_total == 0) {
+        n_total = check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums);
+    }
+    const uint64_t base_seed = mpi_shared_seed(comm, seed);
+    const RankRange range = mpi_rank_range(comm, n_tables);
+    if (!result) {
+        result = reinterpret_cast<double*>(std::malloc(std::max<size_t>(range.n_tables, 1) * sizeof(double)));
+        if (!result) throw std::bad_alloc();
+    }
+    const TableStatistic<T> table_statistic(statistic, n_row, n_col, n_row_sums, n_col_sums, n_total);
+    with_factorial_table(factorial_table, n_total, [&](const auto& table) {
+        generate_statistics_impl<T>(
+            range.n_tables, n_row, n_col, n_row_sums, n_col_sums, n_total, table_statistic, n_threads, base_seed,
+            table, result, true, kernel, range.first
+        );
+    });
+    return result;
+}  // generate_statistics_mpi
+
+}  // namespace details
+
+/* The tables of this rank when `n_tables` tables are split over the ranks of `comm`.
+ *
+ *  The ranges are contiguous and in the order of the ranks, the first
+ *  `n_tables % size` ranks hold one table more than the others.
+ */
+RankRange mpi_rank_range(MPI_Comm comm, const size_t n_tables);
+
+/* Generate this rank's share of `n_tables` random two-way contingency tables.
+ *
+ *  Collective over `comm`. Table `i` is drawn from the stream derived from
+ *  `seed` and `i`, the tables of all ranks combined in the order of the
+ *  ranks are those of `generate_contingency_tables` with `reproducible = true`.
+ *
+ * Parameters
+ * ----------
+ * comm : the communicator, every rank must pass the same arguments
+ * n_tables : total number of tables over all ranks
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn on rank 0 as described by
+ *        `generate_contingency_tables` and broadcast.
+ * result : optional, pointer to the memory where the tables of this rank will
+ *          be stored, must be of size [mpi_rank_range(comm, n_tables).n_tables * n_row * n_col]
+ *
+ * See `generate_contingency_tables` for the other parameters.
+ *
+ *  Returns
+ *  -------
+ *  result : pointer to the memory where the tables of the rank have been stored
+ */
+int* generate_contingency_tables_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    int* result = nullptr,
+    const Kernel kernel = Kernel::scalar
+);
+
+/* Generate this rank's share of `n_tables` random two-way contingency tables.
+ *
+ *  See the `int` overload for the description of the arguments.
+ */
+int64_t* generate_contingency_tables_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    int64_t* result = nullptr,
+    const Kernel kernel = Kernel::scalar
+);
+
+/* Statistics of this rank's share of `n_tables` random tables.
+ *
+ *  Collective over `comm`. The statistics of the tables of
+ *  `generate_contingency_tables_mpi`, reduce them over the ranks with
+ *  `gather_statistics_mpi`, `count_statistics_mpi` or `histogram_statistics_mpi`.
+ *
+ * Parameters
+ * ----------
+ * statistic : the statistic to compute
+ * result : optional, pointer to the memory of size [mpi_rank_range(comm, n_tables).n_tables]
+ *          where the statistics of this rank will be stored
+ *
+ * See `generate_contingency_tables_mpi` for the other parameters.
+ *
+ *  Returns
+ *  -------
+ *  result : pointer to the memory where the statistics of the rank have been stored
+ */
+double* generate_statistics_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    double* result = nullptr,
+    const Kernel kernel = Kernel::scalar
+);
+
+/* Statistics of this rank's share of `n_tables` random tables.
+ *
+ *  See the `int` overload for the description of the arguments.
+ */
+double* generate_statistics_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    double* result = nullptr,
+    const Kernel kernel = Kernel::scalar
+);
+
+/* Gather the statistics of all ranks on `root` in the order of the tables.
+ *
+ *  Collective over `comm`.
+ *
+ * Parameters
+ * ----------
+ * comm : the communicator
+ * n_tables : total number of tables over all ranks
+ * local : the statistics of this rank, see `generate_statistics_mpi`
+ * result : pointer to memory of size [n_tables] on `root`, ignored on the other ranks
+ * root : optional, default = 0, the rank that receives the statistics
+ */
+void gather_statistics_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const double* local,
+    double* result,
+    const int root = 0
+);
+
+/* Number of tables over all ranks with a statistic >= threshold.
+ *
+ *  Collective over `comm`, the count is returned on every rank.
+ *
+ * Parameters
+ * ----------
+ * comm : the communicator
+ * n_tables : total number of tables over all ranks
+ * local : the statistics of this rank, see `generate_statistics_mpi`
+ * threshold : the tables with a statistic >= threshold are counted
+ *
+ *  Returns
+ *  -------
+ *  count : the number of tables with a statistic >= threshold
+ */
+uint64_t count_statistics_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const double* local,
+    const double threshold
+);
+
+/* Histogram of the statistics over all ranks.
+ *
+ *  Collective over `comm`. The `n_bins` bins have equal width over
+ *  [lower, upper), smaller values are counted in the first bin and larger
+ *  values in the last bin. The counts are returned on every rank.
+ *
+ * Parameters
+ * ----------
+ * comm : the communicator
+ * n_tables : total number of tables over all ranks
+ * local : the statistics of this rank, see `generate_statistics_mpi`
+ * n_bins : the number of bins, must be positive
+ * lower : the lower edge of the first bin
+ * upper : the upper edge of the last bin, must be larger than `lower`
+ * counts : pointer to memory of size [n_bins] where the counts are stored
+ */
+void histogram_statistics_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const double* local,
+    const size_t n_bins,
+    const double lower,
+    const double upper,
+    uint64_t* counts
+);
+
+}  // namespace patefield
+#endif  // PATEFIELD_HAS_MPI_SUPPORT
+#endif  // INCLUDE_PATEFIELD_MPI_HPP_
@@ -0,0 +1,209 @@
+/* numa.hpp -- NUMA placement of the workers and the factorial table.
+ * Copyright 2022 R. Urlus
+ *
+ * On machines with several sockets a page lives on the node of the thread
+ * that first writes it. `NumaThreadPool` pins its workers to the nodes such
+ * that every block of tables is written, and thus placed, by a worker on one
+ * node, while each node reads its own copy of the factorial table.
+ * Requires the library to be built with `PATEFIELD_ENABLE_NUMA`, otherwise
+ * the pool behaves as a `ThreadPool` on a single node.
+ */
+
+#ifndef INCLUDE_PATEFIELD_NUMA_HPP_
+#define INCLUDE_PATEFIELD_NUMA_HPP_
+
+#if defined(PATEFIELD_HAS_NUMA_SUPPORT)
+#include <numa.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <patefield/executor.hpp>
+#include <patefield/factorial.hpp>
+#include <patefield/thread_pool.hpp>
+
+namespace patefield {
+namespace details {
+
+/* Number of configured NUMA nodes, 1 when NUMA is not available. */
+inline size_t numa_node_count() {
+#if defined(PATEFIELD_HAS_NUMA_SUPPORT)
+    if (numa_available() < 0) {
+        return 1;
+    }
+    return static_cast<size_t>(std::max(numa_num_configured_nodes(), 1));
+#else
+    return 1;
+#endif
+}  // numa_node_count
+
+/* Node of the CPU the calling thread runs on. */
+inline size_t current_numa_node() {
+#if defined(PATEFIELD_HAS_NUMA_SUPPORT)
+    const int cpu = sched_getcpu();
+    const int node = cpu < 0 ? 0 : numa_node_of_cpu(cpu);
+    return node < 0 ? 0 : static_cast<size_t>(node);
+#else
+    return 0;
+#endif
+}  // current_numa_node
+
+/* Restrict the calling thread and its allocations to `node`. */
+inline void pin_to_numa_node(const size_t node) {
+#if defined(PATEFIELD_HAS_NUMA_SUPPORT)
+    if (numa_available() >= 0) {
+        numa_run_on_node(static_cast<int>(node));
+        numa_set_preferred(static_cast<int>(node));
+    }
+#else
+    (void)node;
+#endif
+}  // pin_to_numa_node
+
+/* NodeTables provides the factorial table to read on the node of the calling thread.
+ *
+ *  Only dense tables are replicated, the sparse `LogFactorial` is shared.
+ */
+template<typename Table>
+class NodeTables {
+    const Table& table_;
+
+ public:
+    NodeTables(const Table& table, const int64_t, const size_t) : table_{table} {}
+    const Table& local() const { return table_; }
+};  // NodeTables
+
+/* Copy of the first `size` log-factorials of `table` on `node`, null when the allocation fails. */
+inline std::shared_ptr<const double> replicate_on_node(const double* table, const size_t size, const size_t node) {
+#if defined(PATEFIELD_HAS_NUMA_SUPPORT)
+    const size_t n_bytes = size * sizeof(double);
+    double* replica = static_cast<double*>(numa_alloc_onnode(n_bytes, static_cast<int>(node)));
+    if (!replica) {
+        return nullptr;
+    }
+    std::memcpy(replica, table, n_bytes);
+    return std::shared_ptr<const double>(replica, [n_bytes](const double* ptr) {
+        numa_free(const_cast<double*>(ptr), n_bytes);
+    });
+#else
+    (void)table;
+    (void)size;
+    (void)node;
+    return nullptr;
+#endif
+}  // replicate_on_node
+
+/* Dense tables are read from a copy on every node.
+ *
+ *  The replicas of the process-wide table are kept in the shared state
+ *  and reused until the table grows or is released, a caller-owned table
+ *  is copied for the lifetime of the `NodeTables`.
+ */
+template<>
+class NodeTables<const double*> {
+    const double* table_;
+    std::vector<std::shared_ptr<const double>> replicas_;
+
+ public:
+    NodeTables(const double* table, const int64_t n_total, const size_t n_nodes) : table_{table} {
+#if defined(PATEFIELD_HAS_NUMA_SUPPORT)
+        if (n_nodes <= 1 || numa_available() < 0) {
+            return;
+        }
+        SharedFactorialState& state = shared_factorial_state();
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (state.table && state.table->data() == table) {
+                if (state.node_replicas.size() < n_nodes) {
+                    state.node_replicas.resize(n_nodes);
+                }
+                for (size_t node = 0; node < n_nodes; node++) {
+                    if (!state.node_replicas[node]) {
+                        state.node_replicas[node] = replicate_on_node(table, state.table->size(), node);
+                    }
+                }
+                replicas_.assign(state.node_replicas.begin(), state.node_replicas.begin() + n_nodes);
+                return;
+            }
+        }
+        replicas_.resize(n_nodes);
+        for (size_t node = 0; node < n_nodes; node++) {
+            replicas_[node] = replicate_on_node(table, static_cast<size_t>(n_total + 1), node);
+        }
+#else
+        (void)n_total;
+        (void)n_nodes;
+#endif
+    }
+
+    NodeTables(const NodeTables&) = delete;
+    NodeTables& operator=(const NodeTables&) = delete;
+
+    const double* local() const {
+        if (replicas_.empty()) {
+            return table_;
+        }
+        const size_t node = current_numa_node();
+        return node < replicas_.size() && replicas_[node] ? replicas_[node].get() : table_;
+    }
+};  // NodeTables<const double*>
+
+/* Number of nodes the active executor spreads its workers over. */
+inline size_t executor_numa_nodes(const size_t n_threads) {
+    Executor* executor = get_executor();
+    return n_threads > 1 && executor ? executor->numa_nodes() : 1;
+}
+
+}  // namespace details
+
+/* ThreadPool with its workers pinned to the NUMA nodes.
+ *
+ *  The workers are divided into contiguous groups, one per node, such that
+ *  worker `w` runs on node `w * n_nodes / size()`. A worker only steals
+ *  tasks from workers on its own node, a task is therefore always run on the
+ *  node of the worker it was assigned to. Register the pool with
+ *  `patefield::set_executor` and use `n_threads = size()`: every block of the
+ *  result is then generated on the node of its worker and the pages of that
+ *  block are placed on that node on first touch. Every node reads its own
+ *  copy of a dense factorial table, the copies of the process-wide table are
+ *  made once and kept until the table grows, a caller-owned table is copied
+ *  for the duration of each call. This holds for `Layout::column_major` and
+ *  `Layout::row_major` and a `result` that has not been written to, such as
+ *  the buffer allocated by the generators.
+ *
+ * Parameters
+ * ----------
+ * n_threads : optional, default = 0, the number of workers, 0 uses the
+ *             number of hardware threads
+ */
+class NumaThreadPool : public ThreadPool {
+    size_t n_nodes_;
+
+ public:
+    explicit NumaThreadPool(const size_t n_threads = 0) :
+        ThreadPool(n_threads, [n_threads](const size_t worker) {
+            const size_t n_workers = n_threads > 0
+                ? n_threads : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+            details::pin_to_numa_node((worker * details::numa_node_count()) / n_workers);
+        }),
+        n_nodes_{details::numa_node_count()} {}
+
+    size_t numa_nodes() const override { return n_nodes_; }
+
+ protected:
+    bool can_steal(const size_t worker, const size_t victim) const override {
+        return node_of(worker) == node_of(victim);
+    }
+
+ private:
+    size_t node_of(const size_t worker) const { return (worker * n_nodes_) / size(); }
+};  // NumaThreadPool
+
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_NUMA_HPP_
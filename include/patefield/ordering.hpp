@@ -0,0 +1,187 @@
+/* ordering.hpp -- Order of the marginals used for sampling.
+ * Copyright 2022 R. Urlus
+ *
+ * Any order of the rows and columns yields exact samples, but the work done
+ * by `rcont2` depends on it: the last row and column are never sampled, the
+ * `ie == 0` exit only fires once the later columns are exhausted and the
+ * walk from the mode is longer for wide distributions. Which order is
+ * cheapest depends on the marginals, so candidate orders are compared on a
+ * few pilot tables using the number of steps the sampler takes.
+ */
+
+#ifndef INCLUDE_PATEFIELD_ORDERING_HPP_
+#define INCLUDE_PATEFIELD_ORDERING_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include <patefield/commons.hpp>
+#include <patefield/rcont.hpp>
+
+namespace patefield {
+namespace details {
+
+/* Permutation of the marginals, row `l` of the sampled table is row `row_perm[l]` of the caller. */
+template<typename T, isInt<T> = true>
+struct MarginalOrder {
+    std::vector<T> row_perm;
+    std::vector<T> col_perm;
+    std::vector<T> n_row_sums;
+    std::vector<T> n_col_sums;
+
+    MarginalOrder() = default;
+    MarginalOrder(std::vector<T> rows, std::vector<T> cols, const T* row_sums, const T* col_sums) :
+        row_perm{std::move(rows)},
+        col_perm{std::move(cols)},
+        n_row_sums(row_perm.size()),
+        n_col_sums(col_perm.size()) {
+        for (size_t i = 0; i < row_perm.size(); i++) {
+            n_row_sums[i] = row_sums[row_perm[i]];
+        }
+        for (size_t j = 0; j < col_perm.size(); j++) {
+            n_col_sums[j] = col_sums[col_perm[j]];
+        }
+    }
+
+    bool is_identity() const {
+        for (size_t i = 0; i < row_perm.size(); i++) {
+            if (row_perm[i] != static_cast<T>(i)) return false;
+        }
+        for (size_t j = 0; j < col_perm.size(); j++) {
+            if (col_perm[j] != static_cast<T>(j)) return false;
+        }
+        return true;
+    }
+};  // MarginalOrder
+
+/* PermutedSink stores a table sampled in a `MarginalOrder` in the order of the caller.
+ *
+ *   Sink for `rcont2_sink`, cell (l, m) is stored at
+ *   `result[row_perm[l] * row_stride + col_perm[m] * col_stride]`.
+ */
+template<typename S, typename T, isInt<S> = true>
+struct PermutedSink {
+    S* result;
+    size_t row_stride;
+    size_t col_stride;
+    const T* row_perm;
+    const T* col_perm;
+
+    inline void set(const T l, const T m, const T value) {
+        result[row_perm[l] * row_stride + col_perm[m] * col_stride] = static_cast<S>(value);
+    }
+
+    inline void zeros(const T l, const T m, const T end) {
+        S* row = result + row_perm[l] * row_stride;
+        for (T j = m; j < end; j++) {
+            row[col_perm[j] * col_stride] = 0;
+        }
+    }
+};  // PermutedSink
+
+/* CostCounter is a `ModeWalk` that tallies the work done per table.
+ *
+ *   Every drawn cell costs `cell_cost`, in units of walk steps, for the
+ *   probability of the mode, on top of the steps walked from the mode.
+ */
+struct CostCounter {
+    static constexpr uint64_t cell_cost = 8;
+    ModeWalk walk;
+    uint64_t cost = 0;
+
+    template<typename T, typename Table, isInt<T> = true>
+    inline T draw(const T ia, const T id, const T ie, const Table& factorial_table, pcg64_dxsm& rng) {
+        const T value = walk.template draw<T>(ia, id, ie, factorial_table, rng);
+        const int64_t mode = static_cast<int64_t>(static_cast<double>(ia) * static_cast<double>(id)
+            / static_cast<double>(ie) + 0.5);
+        const int64_t distance = static_cast<int64_t>(value) - mode;
+        // the walk alternates between both sides of the mode
+        cost += cell_cost + 2 * static_cast<uint64_t>(distance < 0 ? -distance : distance);
+        return value;
+    }
+};  // CostCounter
+
+/* Sink that discards the cells. */
+struct NullSink {
+    template<typename T>
+    inline void set(const T, const T, const T) {}
+    template<typename T>
+    inline void zeros(const T, const T, const T) {}
+};
+
+/* Number of pilot tables sampled per candidate order. */
+constexpr int n_pilot_tables = 4;
+
+/* Smallest batch for which the pilot tables are worth their cost. */
+constexpr size_t min_reorder_tables = 200;
+
+/* Choose the order of the marginals that minimizes the work of `rcont2`.
+ *
+ *  The candidates are the order of the caller and the row and column sums
+ *  each sorted ascending or descending. Every candidate samples the same
+ *  number of pilot tables from a fixed stream, the order of the caller is
+ *  kept unless another candidate is at least 10% cheaper.
+ */
+template<typename T, typename Table, isInt<T> = true>
+inline MarginalOrder<T> choose_marginal_order(
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const int64_t n_total,
+    const Table& factorial_table
+) {
+    std::vector<T> rows(static_cast<size_t>(n_row));
+    std::vector<T> cols(static_cast<size_t>(n_col));
+    std::iota(rows.begin(), rows.end(), T(0));
+    std::iota(cols.begin(), cols.end(), T(0));
+
+    auto sorted = [](std::vector<T> perm, const T* sums, const bool ascending) {
+        std::stable_sort(perm.begin(), perm.end(), [sums, ascending](const T a, const T b) {
+            return ascending ? sums[a] < sums[b] : sums[a] > sums[b];
+        });
+        return perm;
+    };
+
+    std::vector<MarginalOrder<T>> candidates;
+    candidates.emplace_back(rows, cols, n_row_sums, n_col_sums);
+    for (const bool rows_ascending : {true, false}) {
+        for (const bool cols_ascending : {true, false}) {
+            candidates.emplace_back(
+                sorted(rows, n_row_sums, rows_ascending), sorted(cols, n_col_sums, cols_ascending), n_row_sums,
+                n_col_sums
+            );
+        }
+    }
+
+    std::unique_ptr<int64_t[]> jwork(new int64_t[n_col]);
+    NullSink sink;
+    size_t best = 0;
+    uint64_t best_cost = 0;
+    for (size_t c = 0; c < candidates.size(); c++) {
+        const MarginalOrder<T>& order = candidates[c];
+        CostCounter counter;
+        pcg64_dxsm rng;
+        for (int t = 0; t < n_pilot_tables; t++) {
+            seed_table_stream(rng, 0x9E3779B97F4A7C15ULL, static_cast<uint64_t>(t));
+            rcont2_sink<T, CostCounter>(
+                n_row, n_col, static_cast<T>(n_total), order.n_row_sums.data(), order.n_col_sums.data(), sink,
+                factorial_table, rng, jwork.get(), counter
+            );
+        }
+        if (c == 0) {
+            best_cost = counter.cost;
+        } else if (counter.cost * 10 < best_cost * 9) {
+            best = c;
+            best_cost = counter.cost;
+        }
+    }
+    return candidates[best];
+}  // choose_marginal_order
+
+}  // namespace details
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_ORDERING_HPP_
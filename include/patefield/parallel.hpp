@@ -0,0 +1,106 @@
+/* parallel.hpp -- Dispatch of parallel loops to the available threading runtime.
+ * Copyright 2022 R. Urlus
+ *
+ * The generators express their parallel loops through the functions below.
+ * An executor registered with `set_executor` takes precedence, otherwise
+ * OpenMP is used when the library is built with it and the built-in
+ * `ThreadPool` when it is not.
+ */
+
+#ifndef INCLUDE_PATEFIELD_PARALLEL_HPP_
+#define INCLUDE_PATEFIELD_PARALLEL_HPP_
+
+#if defined(PATEFIELD_HAS_OPENMP_SUPPORT)
+#include <omp.h>
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <functional>
+
+#include <patefield/executor.hpp>
+#include <patefield/thread_pool.hpp>
+
+namespace patefield {
+namespace details {
+
+/* Number of distinct `worker` values `parallel_tasks(n_threads, ...)` passes to its tasks. */
+inline size_t parallel_workers(const size_t n_threads) {
+    if (n_threads <= 1) {
+        return 1;
+    }
+    if (Executor* executor = get_executor()) {
+        return executor->size();
+    }
+#if defined(PATEFIELD_HAS_OPENMP_SUPPORT)
+    return n_threads;
+#else
+    return default_thread_pool().size();
+#endif
+}  // parallel_workers
+
+/* Call `func(task, worker)` for every task in [0, n_tasks) using up to `n_threads` threads.
+ *
+ *  `worker` is in [0, parallel_workers(n_threads)) and identifies the thread
+ *  running the task. The first exception thrown by a task is rethrown.
+ */
+template<typename Func>
+inline void parallel_tasks(const size_t n_threads, const size_t n_tasks, Func&& func) {
+    if (n_tasks == 0) {
+        return;
+    }
+    if (n_threads <= 1 || n_tasks == 1) {
+        for (size_t t = 0; t < n_tasks; t++) {
+            func(t, 0);
+        }
+        return;
+    }
+    if (Executor* executor = get_executor()) {
+        executor->run(n_tasks, std::function<void(size_t, size_t)>(std::ref(func)));
+        return;
+    }
+#if defined(PATEFIELD_HAS_OPENMP_SUPPORT)
+    // exceptions may not leave a parallel region
+    std::exception_ptr error;
+    #pragma omp parallel for num_threads(n_threads) schedule(dynamic) shared(func, error)
+    for (size_t t = 0; t < n_tasks; t++) {
+        try {
+            func(t, static_cast<size_t>(omp_get_thread_num()));
+        } catch (...) {
+            #pragma omp critical(patefield_parallel_error)
+            {
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+#else
+    default_thread_pool().run(n_tasks, std::function<void(size_t, size_t)>(std::ref(func)));
+#endif
+}  // parallel_tasks
+
+/* Split [0, n_items) into `n_blocks` contiguous blocks and call `func(block, first, last)` for each.
+ *
+ *  The split is that of an OpenMP static schedule, the first `n_items % n_blocks`
+ *  blocks hold one item more than the others. Empty blocks are skipped.
+ */
+template<typename Func>
+inline void parallel_blocks(const size_t n_blocks, const size_t n_items, Func&& func) {
+    const size_t n = std::max<size_t>(n_blocks, 1);
+    const size_t quotient = n_items / n;
+    const size_t remainder = n_items % n;
+    parallel_tasks(n, std::min(n, n_items), [&](const size_t block, const size_t) {
+        const size_t first = block * quotient + std::min(block, remainder);
+        const size_t last = first + quotient + (block < remainder ? 1 : 0);
+        func(block, first, last);
+    });
+}  // parallel_blocks
+
+}  // namespace details
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_PARALLEL_HPP_
@@ -5,20 +5,23 @@
 #ifndef INCLUDE_PATEFIELD_PATEFIELD_HPP_
 #define INCLUDE_PATEFIELD_PATEFIELD_HPP_
 
-#if defined(PATEFIELD_HAS_OPENMP_SUPPORT)
-#include <omp.h>
-#endif
-
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <memory>
+#include <numeric>
 #include <random>
 #include <utility>
 #include <stdexcept>
 #include <type_traits>
 
 #include <patefield/commons.hpp>
+#include <patefield/factorial.hpp>
+#include <patefield/numa.hpp>
+#include <patefield/ordering.hpp>
+#include <patefield/parallel.hpp>
 #include <patefield/rcont.hpp>
+#include <patefield/rcont_simd.hpp>
 
 namespace patefield {
 namespace details {
@@ -45,25 +48,31 @@ inline int64_t check_inputs(const T n_row, const T n_col, const T* n_row_sums, c
         }
     }
 
-    int64_t n_total = std::accumulate(n_col_sums, n_col_sums + n_col, 0);
-    if (n_total != std::accumulate(n_row_sums, n_row_sums + n_row, 0)) {
+    // accumulate in 64 bits, the sum of `int` marginals can exceed the range of `int`
+    const int64_t n_total = std::accumulate(n_col_sums, n_col_sums + n_col, int64_t(0));
+    if (n_total != std::accumulate(n_row_sums, n_row_sums + n_row, int64_t(0))) {
         throw InputError("patefield: the row and column sum vectors do not have the same sum.\n");
     }
+    if (n_total > static_cast<int64_t>(std::numeric_limits<T>::max())) {
+        throw InputError("patefield: the sum of the marginals exceeds the range of the integer type.\n");
+    }
     return n_total;
 }  // check_inputs
 
-template <typename T, isInt<T> = true>
-double* create_factorial_table(const T n_total) {
-    auto table = reinterpret_cast<double*>(std::malloc(static_cast<size_t>(n_total + 1) * sizeof(double)));
-    //  Calculate log-factorials.
-    double x = 0.0;
-    table[0] = 0.0;
-    for (T i = 1; i <= n_total; i++) {
-        x += std::log(static_cast<double>(i));
-        table[i] = x;
+/* Check that every cell of a table with the given sums fits in the storage type `S`. */
+template<typename S, typename T, isInt<S> = true, isInt<T> = true>
+inline void check_storage(const T n_row, const T n_col, const T* n_row_sums, const T* n_col_sums) {
+    // a cell is bounded by both its row and its column sum
+    const int64_t max_row = *std::max_element(n_row_sums, n_row_sums + n_row);
+    const int64_t max_col = *std::max_element(n_col_sums, n_col_sums + n_col);
+    const uint64_t max_cell = static_cast<uint64_t>(std::min(max_row, max_col));
+    if (max_cell > static_cast<uint64_t>(std::numeric_limits<S>::max())) {
+        throw InputError("patefield: the cells of the table do not fit in the storage type.\n");
     }
-    return table;
-}  // create_factorial_table
+}  // check_storage
+
+/* Largest number of columns for which `generate_contingency_table` keeps its scratch space on the stack. */
+constexpr int64_t max_stack_cols = 64;
 
 /* Generate a random two-way contingency table with given sums.
  *
@@ -78,12 +87,15 @@ double* create_factorial_table(const T n_total) {
  * n_col_sums : the column sums, must be > 0;
  * n_total : optional, default = 0, the sum of the column or row sums
  * seed : optional, a seed for the random number generator,
- *        default = 0, i.e. drawn by random_device.
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
  * factorial_table : optional, pointer to table containing the log factorials,
  *                   can be created using `patefield::create_factorial_table`
- *                   Otherwise the factorial_table will be computed.
+ *                   Otherwise the process-wide factorial table is used.
  * result : optional, pointer to the memory where the table will be stored,
- *          must be of size [n_row * n_col] and is expected to be C-contiguous
+ *          must be of size [n_row * n_col] and is stored using `layout`
+ * layout : optional, default = Layout::column_major, the memory layout of `result`,
+ *          cell (i, j) at `i + j * n_row`, `Layout::row_major` stores the cell
+ *          at `i * n_col + j`.
  *
  *  Returns
  *  -------
@@ -95,61 +107,298 @@ inline T* generate_contingency_table(
     const T n_col,
     const T* const n_row_sums,
     const T* const n_col_sums,
-    int64_t n_total = 0,
-    uint64_t seed = 0,
+    int64_t n_total,
+    pcg64_dxsm& rng,
     double* factorial_table = nullptr,
-    T* result = nullptr
+    T* result = nullptr,
+    const Layout layout = Layout::column_major
 ) {
     if (n_total == 0) {
         n_total = details::check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums);
     }
-    if (!factorial_table) {
-        factorial_table = details::create_factorial_table<T>(n_total);
-    }
     if (!result) {
         result = reinterpret_cast<T*>(std::malloc(n_row * n_col * sizeof(T)));
         if (!result) throw std::bad_alloc();
     }
-    pcg64_dxsm rng;
+    const CellStrides strides = cell_strides(layout, n_row, n_col, 1);
+
+    with_factorial_table(factorial_table, n_total, [&](const auto& table) {
+        ModeWalk cell;
+        // small tables do not allocate their scratch space
+        int64_t stack_jwork[max_stack_cols];
+        std::unique_ptr<int64_t[]> heap_jwork;
+        int64_t* jwork = stack_jwork;
+        if (n_col > max_stack_cols) {
+            heap_jwork.reset(new int64_t[n_col]);
+            jwork = heap_jwork.get();
+        }
+        rcont2_strided<T, ModeWalk>(
+            n_row, n_col, n_total, n_row_sums, n_col_sums, result, strides.row, strides.col, table, rng, jwork, cell
+        );
+    });
+    return result;
+} // generate_contingency_table
+
+template<typename T, isInt<T> = true>
+inline T* generate_contingency_table(
+    const T n_row,
+    const T n_col,
+    const T* const n_row_sums,
+    const T* const n_col_sums,
+    int64_t n_total = 0,
+    uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    T* result = nullptr,
+    const Layout layout = Layout::column_major
+) {
+    // unseeded calls continue the engine of the thread
     if (seed == 0) {
-        pcg_seed_seq seed_source;
-        rng.seed(seed_source);
-    } else {
-        rng.seed(seed);
+        return generate_contingency_table<T>(
+            n_row, n_col, n_row_sums, n_col_sums, n_total, thread_engine(), factorial_table, result, layout
+        );
     }
-
-    rcont2<T>(
-        n_row, n_col, n_total, n_row_sums, n_col_sums, result, factorial_table, rng
+    pcg64_dxsm rng(seed);
+    return generate_contingency_table<T>(
+        n_row, n_col, n_row_sums, n_col_sums, n_total, rng, factorial_table, result, layout
     );
-    return result;
 } // generate_contingency_table
 
-/* Generate a random two-way contingency table with given sums.
+/* Generate `n_tables` tables one at a time using `rcont2`.
+ *
+ *  When `order` is set the tables are sampled in that order of the
+ *  marginals and stored in the order of the caller.
+ */
+template<typename T, typename Table, typename S, isInt<T> = true>
+inline void generate_tables_scalar(
+    const size_t n_tables,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    const Table factorial_table,
+    S* result,
+    const bool reproducible,
+    const Layout layout,
+    const MarginalOrder<T>* order = nullptr
+) {
+    const size_t block_size = static_cast<size_t>(n_row) * static_cast<size_t>(n_col);
+    const CellStrides strides = cell_strides(layout, n_row, n_col, n_tables);
+    const NodeTables<Table> node_tables(factorial_table, n_total, executor_numa_nodes(n_threads));
+
+    // draw table `i` into `result`
+    auto draw_table = [&](
+        const size_t i, const Table& local_table, pcg64_dxsm& rng, int64_t* jwork, ModeWalk& cell
+    ) {
+        S* table = result + table_offset(layout, i, block_size);
+        if (order) {
+            PermutedSink<S, T> sink{table, strides.row, strides.col, order->row_perm.data(), order->col_perm.data()};
+            rcont2_sink<T, ModeWalk>(
+                n_row, n_col, n_total, order->n_row_sums.data(), order->n_col_sums.data(), sink, local_table,
+                rng, jwork, cell
+            );
+        } else {
+            rcont2_strided<T, ModeWalk>(
+                n_row, n_col, n_total, n_row_sums, n_col_sums, table, strides.row, strides.col, local_table, rng,
+                jwork, cell
+            );
+        }
+    };
+
+    if (reproducible) {
+        const uint64_t base_seed = resolve_seed(seed);
+        parallel_blocks(n_threads, n_tables, [&](const size_t, const size_t first, const size_t last) {
+            const Table& local_table = node_tables.local();
+            pcg64_dxsm rng;
+            ModeWalk cell;
+            std::unique_ptr<int64_t[]> jwork(new int64_t[n_col]);
+            for (size_t i = first; i < last; i++) {
+                seed_table_stream(rng, base_seed, i);
+                draw_table(i, local_table, rng, jwork.get(), cell);
+            }
+        });
+        return;
+    }
+
+    const pcg64_dxsm global_rng(resolve_seed(seed));
+
+    // every block of tables has its own stream
+    parallel_blocks(n_threads, n_tables, [&](const size_t block, const size_t first, const size_t last) {
+        const Table& local_table = node_tables.local();
+        pcg64_dxsm rng = global_rng;
+        rng.set_stream(block + 1);
+        ModeWalk cell;
+        std::unique_ptr<int64_t[]> jwork(new int64_t[n_col]);
+        for (size_t i = first; i < last; i++) {
+            draw_table(i, local_table, rng, jwork.get(), cell);
+        }
+    });
+}  // generate_tables_scalar
+
+/* Generate `n_tables` tables in chunks of `simd_lanes` using `rcont2_simd`. */
+template<typename T, typename Table, typename S, isInt<T> = true>
+inline void generate_tables_simd(
+    const size_t n_tables,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    const Table factorial_table,
+    S* result,
+    const bool reproducible,
+    const Layout layout
+) {
+    constexpr size_t W = simd_lanes;
+    const size_t block_size = static_cast<size_t>(n_row) * static_cast<size_t>(n_col);
+    const size_t n_chunks = (n_tables + W - 1) / W;
+    const uint64_t base_seed = resolve_seed(seed);
+    const CellStrides strides = cell_strides(layout, n_row, n_col, n_tables);
+    const NodeTables<Table> node_tables(factorial_table, n_total, executor_numa_nodes(n_threads));
+
+    parallel_blocks(n_threads, n_chunks, [&](const size_t block, const size_t first, const size_t last) {
+        const Table& local_table = node_tables.local();
+        pcg64_dxsm lane_rngs[W];
+        pcg64_dxsm* rngs[W];
+        S* results[W];
+        std::unique_ptr<int64_t[]> jwork(new int64_t[W * static_cast<size_t>(n_col)]);
+
+        if (!reproducible) {
+            // all lanes share the stream of the block
+            lane_rngs[0].seed(base_seed);
+            lane_rngs[0].set_stream(block + 1);
+        }
+        for (size_t k = 0; k < W; k++) {
+            rngs[k] = reproducible ? &lane_rngs[k] : &lane_rngs[0];
+        }
+
+        for (size_t c = first; c < last; c++) {
+            const size_t offset = c * W;
+            const size_t n_lanes = std::min(W, n_tables - offset);
+            for (size_t k = 0; k < W; k++) {
+                // surplus lanes are not written to but must point to valid memory
+                const size_t i = offset + std::min(k, n_lanes - 1);
+                results[k] = result + table_offset(layout, i, block_size);
+                if (reproducible && k < n_lanes) {
+                    seed_table_stream(lane_rngs[k], base_seed, i);
+                }
+            }
+            rcont2_simd_strided<T, W>(
+                n_lanes, n_row, n_col, n_total, n_row_sums, n_col_sums, results, strides.row, strides.col,
+                local_table, rngs, jwork.get()
+            );
+        }
+    });
+}  // generate_tables_simd
+
+/* Generate the tables [first, first + n_tables) into `result`.
+ *
+ *  Table `i` is drawn from its own stream derived from `base_seed` and `i`
+ *  which makes the tables identical to those of the reproducible mode of
+ *  `generate_contingency_tables`, independent of how the range is split.
+ *  `jwork` is scratch space of size [simd_lanes * n_col].
+ */
+template<typename T, typename Table, isInt<T> = true>
+inline void generate_table_range(
+    const size_t first,
+    const size_t n_tables,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const int64_t n_total,
+    const uint64_t base_seed,
+    const Table& factorial_table,
+    T* result,
+    const Kernel kernel,
+    int64_t* jwork
+) {
+    const size_t block_size = static_cast<size_t>(n_row) * static_cast<size_t>(n_col);
+    if (kernel != Kernel::simd) {
+        pcg64_dxsm rng;
+        for (size_t i = 0; i < n_tables; i++) {
+            seed_table_stream(rng, base_seed, first + i);
+            rcont2<T>(
+                n_row, n_col, n_total, n_row_sums, n_col_sums, result + (i * block_size), factorial_table, rng, jwork
+            );
+        }
+        return;
+    }
+
+    constexpr size_t W = simd_lanes;
+    pcg64_dxsm lane_rngs[W];
+    pcg64_dxsm* rngs[W];
+    T* results[W];
+    for (size_t k = 0; k < W; k++) {
+        rngs[k] = &lane_rngs[k];
+    }
+    for (size_t offset = 0; offset < n_tables; offset += W) {
+        const size_t n_lanes = std::min(W, n_tables - offset);
+        for (size_t k = 0; k < W; k++) {
+            // surplus lanes are not written to but must point to valid memory
+            const size_t i = offset + std::min(k, n_lanes - 1);
+            results[k] = result + (i * block_size);
+            if (k < n_lanes) {
+                seed_table_stream(lane_rngs[k], base_seed, first + i);
+            }
+        }
+        rcont2_simd<T, W>(
+            n_lanes, n_row, n_col, n_total, n_row_sums, n_col_sums, results, factorial_table, rngs, jwork
+        );
+    }
+}  // generate_table_range
+
+/* Generate `n_tables` random two-way contingency tables with given sums.
  *
  *  It is possible to specify row and column sum vectors which
  *  correspond to no table at all.
+ *  The tables are computed using `T` and stored as `S`, e.g. `uint16_t`
+ *  to reduce the memory traffic, an `InputError` is thrown when a cell
+ *  could exceed the range of `S`.
  *
  * Parameters
  * ----------
+ * n_tables : number of tables to generate
  * n_row : number of rows in the table, must be >= 2;
  * n_col : number of columns in the table, must be >= 2;
  * n_row_sums : the row sums, must be > 0;
  * n_col_sums : the column sums, must be > 0;
  * n_total : optional, default = 0, the sum of the column or row sums
+ * n_threads : optional, default = 1, the number of threads used to generate
+ *             the tables
  * seed : optional, a seed for the random number generator,
- *        default = 0, i.e. drawn by random_device.
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
  * factorial_table : optional, pointer to table containing the log factorials,
  *                   can be created using `patefield::create_factorial_table`
- *                   Otherwise the factorial_table will be computed.
- * result : optional, pointer to the memory where the table will be stored,
- *          must be of size [n_row * n_col] and is expected to be C-contiguous
+ *                   Otherwise the process-wide factorial table is used.
+ * result : optional, pointer to the memory where the tables will be stored,
+ *          must be of size [n_tables * n_row * n_col] and is stored using `layout`
+ * reproducible : optional, default = false, draw table `i` from its own
+ *                random stream derived from `seed` and `i` such that the
+ *                result does not depend on `n_threads`.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables, `Kernel::simd` generates `details::simd_lanes`
+ *          tables in lockstep.
+ * layout : optional, default = Layout::column_major, the memory layout of `result`,
+ *          table `i` starts at `i * n_row * n_col` and stores cell (i, j) at `i + j * n_row`.
+ *          `Layout::row_major` stores the cell at `i * n_col + j` and writes each table
+ *          sequentially, `Layout::cell_major` stores cell (i, j) of table `t`
+ *          at `(i * n_col + j) * n_tables + t`.
+ * reorder_marginals : optional, default = false, sample the rows and columns in
+ *                     the order that minimizes the work of the sampler, the
+ *                     tables are stored in the order of `n_row_sums` and `n_col_sums`.
+ *                     Only used by `Kernel::scalar` for batches of at least 200 tables.
  *
  *  Returns
  *  -------
  *  result : pointer to the memory where the table has been stored
  */
-template<typename T, isInt<T> = true>
-inline T* generate_contingency_tables(
+template<typename T, typename S = T, isInt<T> = true, isInt<S> = true>
+inline S* generate_contingency_tables(
     const size_t n_tables,
     const T n_row,
     const T n_col,
@@ -159,46 +408,89 @@ inline T* generate_contingency_tables(
     const size_t n_threads = 1,
     const uint64_t seed = 0,
     double* factorial_table = nullptr,
-    T* result = nullptr
+    S* result = nullptr,
+    const bool reproducible = false,
+    const Kernel kernel = Kernel::scalar,
+    const Layout layout = Layout::column_major,
+    const bool reorder_marginals = false
 ) {
     if (n_total == 0) {
         n_total = details::check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums);
     }
-    if (!factorial_table) {
-        factorial_table = details::create_factorial_table<T>(n_total);
+    if (!std::is_same<S, T>::value) {
+        details::check_storage<S>(n_row, n_col, n_row_sums, n_col_sums);
     }
     const size_t block_size = static_cast<size_t>(n_row) * static_cast<size_t>(n_col);
     if (!result) {
-        result = reinterpret_cast<T*>(std::malloc(block_size * sizeof(T) * n_tables));
+        result = reinterpret_cast<S*>(std::malloc(block_size * sizeof(S) * n_tables));
         if (!result) throw std::bad_alloc();
     }
 
-    pcg64_dxsm global_rng;
-    if (seed == 0) {
-        pcg_seed_seq seed_source;
-        global_rng.seed(seed_source);
-    } else {
-        global_rng.seed(seed);
-    }
-
-    #pragma omp parallel num_threads(n_threads) shared(global_rng, n_row, n_col, n_row_sums, n_col_sums, factorial_table, result)
-    {
-        pcg64_dxsm rng = global_rng;
-        rng.set_stream(omp_get_thread_num() + 1);
-
-        #pragma omp for
-        for (size_t i = 0; i < n_tables; i++) {
-            rcont2<T>(
-                n_row, n_col, n_total, n_row_sums, n_col_sums, result + (i * block_size), factorial_table, rng
+    with_factorial_table(factorial_table, n_total, [&](const auto& table) {
+        // small batches do not recover the cost of the pilot tables, the lanes
+        // of the simd kernel run in lockstep and gain too little from it
+        const bool reorder = reorder_marginals && kernel != Kernel::simd && n_tables >= min_reorder_tables;
+        MarginalOrder<T> order;
+        if (reorder) {
+            order = choose_marginal_order<T>(n_row, n_col, n_row_sums, n_col_sums, n_total, table);
+        }
+        const MarginalOrder<T>* order_ptr = reorder && !order.is_identity() ? &order : nullptr;
+        if (kernel == Kernel::simd) {
+            generate_tables_simd<T>(
+                n_tables, n_row, n_col, n_row_sums, n_col_sums, n_total, n_threads, seed, table, result, reproducible,
+                layout
+            );
+        } else {
+            generate_tables_scalar<T>(
+                n_tables, n_row, n_col, n_row_sums, n_col_sums, n_total, n_threads, seed, table, result, reproducible,
+                layout, order_ptr
             );
         }
-    }  // pragma parallel
-
+    });
     return result;
 } // generate_contingency_tables
 
 }  // namespace details
 
+/* Compute the log-factorials for [0, n_total].
+ *
+ * Parameters
+ * ----------
+ * n_total : the sum of the column or row sums
+ *
+ *  Returns
+ *  -------
+ *  table : pointer to the table of size [n_total + 1], should be released with `std::free`
+ */
+double* create_factorial_table(const int n_total);
+
+/* Compute the log-factorials for [0, n_total].
+ *
+ * Parameters
+ * ----------
+ * n_total : the sum of the column or row sums
+ *
+ *  Returns
+ *  -------
+ *  table : pointer to the table of size [n_total + 1], should be released with `std::free`
+ */
+double* create_factorial_table(const int64_t n_total);
+
+/* Set the largest argument stored by the process-wide factorial table.
+ *
+ *  The process-wide table is used when no `factorial_table` is passed, it
+ *  grows on demand and is shared by all threads. Log-factorials of larger
+ *  arguments are computed using the Stirling series. Defaults to 2^24 - 1.
+ *
+ * Parameters
+ * ----------
+ * n_max : largest argument to store, at least 1023
+ */
+void set_factorial_table_limit(const int64_t n_max);
+
+/* Release the memory of the process-wide factorial table. */
+void release_factorial_table();
+
 /* Generate a random two-way contingency table with given sums.
  *
  *  It is possible to specify row and column sum vectors which
@@ -212,12 +504,15 @@ inline T* generate_contingency_tables(
  * n_col_sums : the column sums, must be > 0;
  * n_total : optional, default = 0, the sum of the column or row sums
  * seed : optional, a seed for the random number generator,
- *        default = 0, i.e. drawn by random_device.
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
  * factorial_table : optional, pointer to table containing the log factorials,
  *                   can be created using `patefield::create_factorial_table`
- *                   Otherwise the factorial_table will be computed.
+ *                   Otherwise the process-wide factorial table is used.
  * result : optional, pointer to the memory where the table will be stored,
- *          must be of size [n_row * n_col] and is expected to be C-contiguous
+ *          must be of size [n_row * n_col] and is stored using `layout`
+ * layout : optional, default = Layout::column_major, the memory layout of `result`,
+ *          cell (i, j) at `i + j * n_row`, `Layout::row_major` stores the cell
+ *          at `i * n_col + j`.
  *
  *  Returns
  *  -------
@@ -231,7 +526,8 @@ int* generate_contingency_table(
     int64_t n_total,
     uint64_t seed = 0,
     double* factorial_table = nullptr,
-    int* result = nullptr
+    int* result = nullptr,
+    const Layout layout = Layout::column_major
 );
 
 /* Generate a random two-way contingency table with given sums.
@@ -247,12 +543,15 @@ int* generate_contingency_table(
  * n_col_sums : the column sums, must be > 0;
  * n_total : optional, default = 0, the sum of the column or row sums
  * seed : optional, a seed for the random number generator,
- *        default = 0, i.e. drawn by random_device.
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
  * factorial_table : optional, pointer to table containing the log factorials,
  *                   can be created using `patefield::create_factorial_table`
- *                   Otherwise the factorial_table will be computed.
+ *                   Otherwise the process-wide factorial table is used.
  * result : optional, pointer to the memory where the table will be stored,
- *          must be of size [n_row * n_col] and is expected to be C-contiguous
+ *          must be of size [n_row * n_col] and is stored using `layout`
+ * layout : optional, default = Layout::column_major, the memory layout of `result`,
+ *          cell (i, j) at `i + j * n_row`, `Layout::row_major` stores the cell
+ *          at `i * n_col + j`.
  *
  *  Returns
  *  -------
@@ -266,28 +565,49 @@ int64_t* generate_contingency_table(
     int64_t n_total,
     uint64_t seed = 0,
     double* factorial_table = nullptr,
-    int64_t* result = nullptr
+    int64_t* result = nullptr,
+    const Layout layout = Layout::column_major
 );
 
-/* Generate a random two-way contingency table with given sums.
+/* Generate `n_tables` random two-way contingency tables with given sums.
  *
  *  It is possible to specify row and column sum vectors which
  *  correspond to no table at all.
  *
  * Parameters
  * ----------
+ * n_tables : number of tables to generate
  * n_row : number of rows in the table, must be >= 2;
  * n_col : number of columns in the table, must be >= 2;
  * n_row_sums : the row sums, must be > 0;
  * n_col_sums : the column sums, must be > 0;
  * n_total : optional, default = 0, the sum of the column or row sums
+ * n_threads : optional, default = 1, the number of threads used to generate
+ *             the tables
  * seed : optional, a seed for the random number generator,
- *        default = 0, i.e. drawn by random_device.
+ *        default = 0, i.e. drawn from the engine of the calling thread
+ *        which is seeded from random_device on its first use, and again
+ *        in the child after a fork, see `details::resolve_seed`.
  * factorial_table : optional, pointer to table containing the log factorials,
  *                   can be created using `patefield::create_factorial_table`
- *                   Otherwise the factorial_table will be computed.
- * result : optional, pointer to the memory where the table will be stored,
- *          must be of size [n_row * n_col] and is expected to be C-contiguous
+ *                   Otherwise the process-wide factorial table is used.
+ * result : optional, pointer to the memory where the tables will be stored,
+ *          must be of size [n_tables * n_row * n_col] and is stored using `layout`
+ * reproducible : optional, default = false, draw table `i` from its own
+ *                random stream derived from `seed` and `i` such that the
+ *                result does not depend on `n_threads`.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables, `Kernel::simd` generates `details::simd_lanes`
+ *          tables in lockstep.
+ * layout : optional, default = Layout::column_major, the memory layout of `result`,
+ *          table `i` starts at `i * n_row * n_col` and stores cell (i, j) at `i + j * n_row`.
+ *          `Layout::row_major` stores the cell at `i * n_col + j` and writes each table
+ *          sequentially, `Layout::cell_major` stores cell (i, j) of table `t`
+ *          at `(i * n_col + j) * n_tables + t`.
+ * reorder_marginals : optional, default = false, sample the rows and columns in
+ *                     the order that minimizes the work of the sampler, the
+ *                     tables are stored in the order of `n_row_sums` and `n_col_sums`.
+ *                     Only used by `Kernel::scalar` for batches of at least 200 tables.
  *
  *  Returns
  *  -------
@@ -303,28 +623,50 @@ int* generate_contingency_tables(
     const size_t n_threads = 1,
     const uint64_t seed = 0,
     double* factorial_table = nullptr,
-    int* result = nullptr
+    int* result = nullptr,
+    const bool reproducible = false,
+    const Kernel kernel = Kernel::scalar,
+    const Layout layout = Layout::column_major,
+    const bool reorder_marginals = false
 );
 
-/* Generate a random two-way contingency table with given sums.
+/* Generate `n_tables` random two-way contingency tables with given sums.
  *
  *  It is possible to specify row and column sum vectors which
  *  correspond to no table at all.
  *
  * Parameters
  * ----------
+ * n_tables : number of tables to generate
  * n_row : number of rows in the table, must be >= 2;
  * n_col : number of columns in the table, must be >= 2;
  * n_row_sums : the row sums, must be > 0;
  * n_col_sums : the column sums, must be > 0;
  * n_total : optional, default = 0, the sum of the column or row sums
+ * n_threads : optional, default = 1, the number of threads used to generate
+ *             the tables
  * seed : optional, a seed for the random number generator,
- *        default = 0, i.e. drawn by random_device.
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
  * factorial_table : optional, pointer to table containing the log factorials,
  *                   can be created using `patefield::create_factorial_table`
- *                   Otherwise the factorial_table will be computed.
- * result : optional, pointer to the memory where the table will be stored,
- *          must be of size [n_row * n_col] and is expected to be C-contiguous
+ *                   Otherwise the process-wide factorial table is used.
+ * result : optional, pointer to the memory where the tables will be stored,
+ *          must be of size [n_tables * n_row * n_col] and is stored using `layout`
+ * reproducible : optional, default = false, draw table `i` from its own
+ *                random stream derived from `seed` and `i` such that the
+ *                result does not depend on `n_threads`.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables, `Kernel::simd` generates `details::simd_lanes`
+ *          tables in lockstep.
+ * layout : optional, default = Layout::column_major, the memory layout of `result`,
+ *          table `i` starts at `i * n_row * n_col` and stores cell (i, j) at `i + j * n_row`.
+ *          `Layout::row_major` stores the cell at `i * n_col + j` and writes each table
+ *          sequentially, `Layout::cell_major` stores cell (i, j) of table `t`
+ *          at `(i * n_col + j) * n_tables + t`.
+ * reorder_marginals : optional, default = false, sample the rows and columns in
+ *                     the order that minimizes the work of the sampler, the
+ *                     tables are stored in the order of `n_row_sums` and `n_col_sums`.
+ *                     Only used by `Kernel::scalar` for batches of at least 200 tables.
  *
  *  Returns
  *  -------
@@ -340,7 +682,192 @@ int64_t* generate_contingency_tables(
     const size_t n_threads = 1,
     const uint64_t seed = 0,
     double* factorial_table = nullptr,
-    int64_t* result = nullptr
+    int64_t* result = nullptr,
+    const bool reproducible = false,
+    const Kernel kernel = Kernel::scalar,
+    const Layout layout = Layout::column_major,
+    const bool reorder_marginals = false
+);
+
+/* Generate a random two-way contingency table using a caller-owned engine.
+ *
+ *  The table is drawn from `rng` which is advanced, repeated calls with the
+ *  same engine neither reseed nor query random_device. See
+ *  `generate_contingency_table` for the description of the other arguments.
+ *
+ *  Returns
+ *  -------
+ *  result : pointer to the memory where the table has been stored
+ */
+int* generate_contingency_table(
+    const int n_row,
+    const int n_col,
+    const int* const n_row_sums,
+    const int* const n_col_sums,
+    int64_t n_total,
+    pcg64_dxsm& rng,
+    double* factorial_table = nullptr,
+    int* result = nullptr,
+    const Layout layout = Layout::column_major
+);
+
+/* Generate a random two-way contingency table using a caller-owned engine.
+ *
+ *  The table is drawn from `rng` which is advanced, repeated calls with the
+ *  same engine neither reseed nor query random_device. See
+ *  `generate_contingency_table` for the description of the other arguments.
+ *
+ *  Returns
+ *  -------
+ *  result : pointer to the memory where the table has been stored
+ */
+int64_t* generate_contingency_table(
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* const n_row_sums,
+    const int64_t* const n_col_sums,
+    int64_t n_total,
+    pcg64_dxsm& rng,
+    double* factorial_table = nullptr,
+    int64_t* result = nullptr,
+    const Layout layout = Layout::column_major
+);
+
+/* Generate `n_tables` random two-way contingency tables using a caller-owned engine.
+ *
+ *  The seed of the batch is drawn from `rng`, repeated calls with the same
+ *  engine neither reseed nor query random_device. See
+ *  `generate_contingency_tables` for the description of the other arguments.
+ *
+ *  Returns
+ *  -------
+ *  result : pointer to the memory where the tables have been stored
+ */
+int* generate_contingency_tables(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads,
+    pcg64_dxsm& rng,
+    double* factorial_table = nullptr,
+    int* result = nullptr,
+    const bool reproducible = false,
+    const Kernel kernel = Kernel::scalar,
+    const Layout layout = Layout::column_major,
+    const bool reorder_marginals = false
+);
+
+/* Generate `n_tables` random two-way contingency tables using a caller-owned engine.
+ *
+ *  The seed of the batch is drawn from `rng`, repeated calls with the same
+ *  engine neither reseed nor query random_device. See
+ *  `generate_contingency_tables` for the description of the other arguments.
+ *
+ *  Returns
+ *  -------
+ *  result : pointer to the memory where the tables have been stored
+ */
+int64_t* generate_contingency_tables(
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads,
+    pcg64_dxsm& rng,
+    double* factorial_table = nullptr,
+    int64_t* result = nullptr,
+    const bool reproducible = false,
+    const Kernel kernel = Kernel::scalar,
+    const Layout layout = Layout::column_major,
+    const bool reorder_marginals = false
+);
+
+/* Generate `n_tables` random two-way contingency tables with given sums stored as `uint8_t`.
+ *
+ *  The tables are computed using `int` and stored as `uint8_t` which reduces
+ *  the memory and bandwidth of the batch, an `InputError` is thrown when a
+ *  cell could exceed the range of `uint8_t`. See `generate_contingency_tables`
+ *  for the description of the arguments.
+ *
+ *  Returns
+ *  -------
+ *  result : pointer to the memory where the tables have been stored
+ */
+uint8_t* generate_contingency_tables_u8(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    uint8_t* result = nullptr,
+    const bool reproducible = false,
+    const Kernel kernel = Kernel::scalar,
+    const Layout layout = Layout::column_major,
+    const bool reorder_marginals = false
+);
+
+/* Generate `n_tables` random two-way contingency tables with given sums stored as `uint16_t`.
+ *
+ *  The tables are computed using `int` and stored as `uint16_t` which reduces
+ *  the memory and bandwidth of the batch, an `InputError` is thrown when a
+ *  cell could exceed the range of `uint16_t`. See `generate_contingency_tables`
+ *  for the description of the arguments.
+ *
+ *  Returns
+ *  -------
+ *  result : pointer to the memory where the tables have been stored
+ */
+uint16_t* generate_contingency_tables_u16(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    uint16_t* result = nullptr,
+    const bool reproducible = false,
+    const Kernel kernel = Kernel::scalar,
+    const Layout layout = Layout::column_major,
+    const bool reorder_marginals = false
+);
+
+/* Generate `n_tables` random two-way contingency tables with given sums stored as `uint32_t`.
+ *
+ *  The tables are computed using `int` and stored as `uint32_t`, an
+ *  `InputError` is thrown when a cell could exceed the range of `uint32_t`. See `generate_contingency_tables`
+ *  for the description of the arguments.
+ *
+ *  Returns
+ *  -------
+ *  result : pointer to the memory where the tables have been stored
+ */
+uint32_t* generate_contingency_tables_u32(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    uint32_t* result = nullptr,
+    const bool reproducible = false,
+    const Kernel kernel = Kernel::scalar,
+    const Layout layout = Layout::column_major,
+    const bool reorder_marginals = false
 );
 
 }  // namespace patefield
@@ -0,0 +1,288 @@
+/* pvalue.hpp -- Monte-Carlo p-values with early stopping.
+ * Copyright 2022 R. Urlus
+ */
+
+#ifndef INCLUDE_PATEFIELD_PVALUE_HPP_
+#define INCLUDE_PATEFIELD_PVALUE_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <patefield/commons.hpp>
+#include <patefield/factorial.hpp>
+#include <patefield/patefield.hpp>
+#include <patefield/statistics.hpp>
+
+namespace patefield {
+
+/* Result of `monte_carlo_pvalue`
+ *
+ * pvalue : (1 + n_extreme) / (1 + n_tables)
+ * lower : lower bound of the Wilson score interval on the p-value
+ * upper : upper bound of the Wilson score interval on the p-value
+ * statistic : the statistic of the observed table
+ * n_tables : number of generated tables
+ * n_extreme : number of generated tables with a statistic at least as large as the observed
+ * converged : true if the interval is within the tolerance, false if `max_tables` was reached
+ * exact : true if the p-value was computed by enumerating all tables, see `exact_pvalue`,
+ *         the bounds of the interval are then the p-value itself
+ */
+struct PValueResult {
+    double pvalue = 1.0;
+    double lower = 0.0;
+    double upper = 1.0;
+    double statistic = 0.0;
+    size_t n_tables = 0;
+    size_t n_extreme = 0;
+    bool converged = false;
+    bool exact = false;
+};
+
+namespace details {
+
+/* Two-sided standard normal quantile belonging to `confidence`. */
+inline double normal_critical_value(const double confidence) {
+    if (!(confidence > 0.0 && confidence < 1.0)) {
+        throw InputError("patefield: confidence should be in (0, 1).\n");
+    }
+    // P(|Z| > z) = erfc(z / sqrt(2)) is decreasing in z, bisect
+    const double alpha = 1.0 - confidence;
+    double lo = 0.0;
+    double hi = 40.0;
+    for (int i = 0; i < 100; i++) {
+        const double mid = 0.5 * (lo + hi);
+        if (std::erfc(mid * 0.70710678118654752440) > alpha) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return 0.5 * (lo + hi);
+}  // normal_critical_value
+
+/* Set the p-value and its Wilson score interval of `result` given critical value `z`. */
+inline void update_pvalue(PValueResult& result, const double z) {
+    const double n = static_cast<double>(result.n_tables + 1);
+    const double p = static_cast<double>(result.n_extreme + 1) / n;
+    const double z2 = z * z;
+    const double denom = 1.0 + z2 / n;
+    const double centre = (p + z2 / (2.0 * n)) / denom;
+    const double half_width = z * std::sqrt(p * (1.0 - p) / n + z2 / (4.0 * n * n)) / denom;
+    result.pvalue = p;
+    result.lower = std::max(centre - half_width, 0.0);
+    result.upper = std::min(centre + half_width, 1.0);
+}  // update_pvalue
+
+/* Check the shape of `observed` and compute its marginals, returns the total. */
+template<typename T, isInt<T> = true>
+inline int64_t observed_marginals(
+    const T* observed,
+    const T n_row,
+    const T n_col,
+    std::vector<T>& n_row_sums,
+    std::vector<T>& n_col_sums
+) {
+    if (n_row <= 1) {
+        throw InputError("patefield: number of rows is less than 2.\n");
+    }
+    if (n_col <= 1) {
+        throw InputError("patefield: number of columns is less than 2.\n");
+    }
+    // accumulated in int64 and checked against the range of T before narrowing
+    const int64_t max_sum = static_cast<int64_t>(std::numeric_limits<T>::max());
+    std::vector<int64_t> row_sums(static_cast<size_t>(n_row), 0);
+    std::vector<int64_t> col_sums(static_cast<size_t>(n_col), 0);
+    // cell (i, j) at `observed[i + j * n_row]`
+    for (T j = 0; j < n_col; j++) {
+        for (T i = 0; i < n_row; i++) {
+            const int64_t value = static_cast<int64_t>(observed[i + j * static_cast<size_t>(n_row)]);
+            if (value < 0) {
+                throw InputError("patefield: an entry of the observed table is negative.\n");
+            }
+            if (row_sums[i] > max_sum - value || col_sums[j] > max_sum - value) {
+                throw InputError("patefield: a marginal of the observed table overflows the type of the table.\n");
+            }
+            row_sums[i] += value;
+            col_sums[j] += value;
+        }
+    }
+    n_row_sums.assign(row_sums.begin(), row_sums.end());
+    n_col_sums.assign(col_sums.begin(), col_sums.end());
+    return check_inputs<T>(n_row, n_col, n_row_sums.data(), n_col_sums.data());
+}  // observed_marginals
+
+/* Threshold of the tables counted as at least as extreme as a table with `statistic`.
+ *
+ *  Guards against tables with the same statistic as the observed differing in rounding.
+ */
+inline double extreme_threshold(const double statistic) {
+    return statistic - 1e-7 * std::max(std::fabs(statistic), 1.0);
+}
+
+template<typename T, isInt<T> = true>
+inline PValueResult monte_carlo_pvalue(
+    const T* observed,
+    const T n_row,
+    const T n_col,
+    const Statistic statistic,
+    const size_t max_tables,
+    const double tolerance,
+    const double confidence = 0.99,
+    const size_t batch_size = 4096,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const Kernel kernel = Kernel::scalar
+) {
+    if (batch_size == 0) {
+        throw InputError("patefield: batch_size must be positive.\n");
+    }
+    if (!(tolerance > 0.0)) {
+        throw InputError("patefield: tolerance must be positive.\n");
+    }
+    std::vector<T> n_row_sums;
+    std::vector<T> n_col_sums;
+    const int64_t n_total = observed_marginals<T>(observed, n_row, n_col, n_row_sums, n_col_sums);
+    const double z = normal_critical_value(confidence);
+
+    const TableStatistic<T> table_statistic(
+        statistic, n_row, n_col, n_row_sums.data(), n_col_sums.data(), n_total
+    );
+    PValueResult result;
+    result.statistic = table_statistic(observed);
+    const double threshold = extreme_threshold(result.statistic);
+
+    const uint64_t base_seed = resolve_seed(seed);
+    std::unique_ptr<double[]> batch(new double[std::min(batch_size, std::max<size_t>(max_tables, 1))]);
+
+    with_factorial_table(factorial_table, n_total, [&](const auto& table) {
+        while (result.n_tables < max_tables) {
+            const size_t n = std::min(batch_size, max_tables - result.n_tables);
+            // the batches continue the per-table streams, the outcome does not depend on `n_threads`
+            generate_statistics_impl<T>(
+                n, n_row, n_col, n_row_sums.data(), n_col_sums.data(), n_total, table_statistic, n_threads,
+                base_seed, table, batch.get(), true, kernel, result.n_tables
+            );
+            for (size_t k = 0; k < n; k++) {
+                result.n_extreme += batch[k] >= threshold;
+            }
+            result.n_tables += n;
+            update_pvalue(result, z);
+            if (0.5 * (result.upper - result.lower) <= tolerance) {
+                result.converged = true;
+                break;
+            }
+        }
+    });
+    update_pvalue(result, z);
+    return result;
+}  // monte_carlo_pvalue
+
+}  // namespace details
+
+/* Estimate the p-value of `observed` under independence by Monte-Carlo.
+ *
+ *  Tables with the marginals of `observed` are generated in batches of
+ *  `batch_size`, after every batch generation stops when the half-width of the
+ *  Wilson score interval on the p-value is at most `tolerance`. The p-value is
+ *  the fraction of tables, including the observed, with a statistic at least
+ *  as large as that of `observed`.
+ *  For a given seed the result does not depend on `n_threads`.
+ *
+ * Parameters
+ * ----------
+ * observed : the observed table of size [n_row * n_col] in the layout of the
+ *            generators, i.e. cell (i, j) at `observed[i + j * n_row]`,
+ *            all row and column sums must be > 0
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * statistic : the test statistic
+ * max_tables : the maximum number of tables to generate
+ * tolerance : the half-width of the confidence interval at which to stop
+ * confidence : optional, default = 0.99, the confidence level of the interval
+ * batch_size : optional, default = 4096, number of tables generated between checks
+ * n_threads : optional, default = 1, the number of threads used to generate
+ *             the tables
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables
+ *
+ *  Returns
+ *  -------
+ *  result : the p-value, its confidence interval and the number of tables used
+ */
+PValueResult monte_carlo_pvalue(
+    const int* observed,
+    const int n_row,
+    const int n_col,
+    const Statistic statistic,
+    const size_t max_tables,
+    const double tolerance,
+    const double confidence = 0.99,
+    const size_t batch_size = 4096,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const Kernel kernel = Kernel::scalar
+);
+
+/* Estimate the p-value of `observed` under independence by Monte-Carlo.
+ *
+ *  Tables with the marginals of `observed` are generated in batches of
+ *  `batch_size`, after every batch generation stops when the half-width of the
+ *  Wilson score interval on the p-value is at most `tolerance`. The p-value is
+ *  the fraction of tables, including the observed, with a statistic at least
+ *  as large as that of `observed`.
+ *  For a given seed the result does not depend on `n_threads`.
+ *
+ * Parameters
+ * ----------
+ * observed : the observed table of size [n_row * n_col] in the layout of the
+ *            generators, i.e. cell (i, j) at `observed[i + j * n_row]`,
+ *            all row and column sums must be > 0
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * statistic : the test statistic
+ * max_tables : the maximum number of tables to generate
+ * tolerance : the half-width of the confidence interval at which to stop
+ * confidence : optional, default = 0.99, the confidence level of the interval
+ * batch_size : optional, default = 4096, number of tables generated between checks
+ * n_threads : optional, default = 1, the number of threads used to generate
+ *             the tables
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables
+ *
+ *  Returns
+ *  -------
+ *  result : the p-value, its confidence interval and the number of tables used
+ */
+PValueResult monte_carlo_pvalue(
+    const int64_t* observed,
+    const int64_t n_row,
+    const int64_t n_col,
+    const Statistic statistic,
+    const size_t max_tables,
+    const double tolerance,
+    const double confidence = 0.99,
+    const size_t batch_size = 4096,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const Kernel kernel = Kernel::scalar
+);
+
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_PVALUE_HPP_
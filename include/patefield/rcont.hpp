@@ -40,77 +40,291 @@
 #include <utility>
 
 #include <patefield/commons.hpp>
+#include <patefield/stats.hpp>
+#include <patefield/uniform.hpp>
 
 namespace patefield {
 namespace details {
 
+/* Integer square root of `n`. */
+constexpr int64_t isqrt(const int64_t n) {
+    int64_t root = 0;
+    int64_t bit = int64_t(1) << 31;
+    while (bit > 0) {
+        const int64_t candidate = root + bit;
+        if (candidate <= n / candidate) {
+            root = candidate;
+        }
+        bit >>= 1;
+    }
+    return root;
+}
+
+/* Largest remaining total for which the walk of a cell can be computed in `T`.
+ *
+ *   The products of `rcont2_walk`, e.g. `(id - nlu) * (ia - nlu)`, are
+ *   bounded by `ie^2` with `ie` the remaining total of the cell. For `int`
+ *   that is 46340, cells with a larger total are walked in `int64_t`.
+ */
+template<typename T, isInt<T> = true>
+constexpr int64_t max_walk_total() {
+    return sizeof(T) >= sizeof(int64_t) ? std::numeric_limits<int64_t>::max()
+                                        : isqrt(static_cast<int64_t>(std::numeric_limits<T>::max()));
+}
+
+/* Walk outwards from the mode of the conditional distribution of a cell.
+ *
+ *   Inverts the conditional (hypergeometric) CDF of the cell by stepping
+ *   up and down from the mode `nlm`, restarting the search with a fresh
+ *   uniform when the walk is exhausted without acceptance.
+ *   The outcome, steps and restarts are counted in `KernelStats`.
+ *   The products are computed in `T`, the remaining total must be at
+ *   most `max_walk_total<T>()`.
+ *
+ * Parameters
+ * ----------
+ * ia : the remaining row sum
+ * id : the remaining column sum
+ * ii : ie - ia - id, with ie the remaining total
+ * nlm : the mode of the conditional distribution
+ * x : the probability of the mode
+ * r : uniform draw over the open set (0, 1)
+ * rng : instantiated random number generator of PCG RNG family
+ * uni_dist : uniform over the open set (0, 1), see `OpenUniform`
+ *
+ *  Returns
+ *  -------
+ *  value : the entry of the cell
+ */
+template<typename T, typename Uniform, isInt<T> = true>
+inline T rcont2_walk(
+    const T ia,
+    const T id,
+    const T ii,
+    const T nlm,
+    const double x,
+    double r,
+    pcg64_dxsm& rng,
+    Uniform& uni_dist
+) {
+    bool lsm;
+    bool lsp;
+    T j;
+    T nll;
+    T nlu;
+    double sumprb;
+    double xu;
+    double y;
+    uint64_t n_steps = 0;
+    uint64_t n_restarts = 0;
+
+    PhaseTimer timer(Stat::walk_ns);
+    auto finish = [&n_steps, &n_restarts](const T value, const Stat outcome) {
+        count_stat(outcome);
+        count_stat(Stat::walk_steps, n_steps);
+        count_stat(Stat::restarts, n_restarts);
+        count_stat(Stat::rng_draws, n_restarts);
+        return value;
+    };
+
+    for (;;) {
+        if (r <= x) {
+            return finish(nlm, Stat::mode_accepts);
+        }
+
+        sumprb = x;
+        xu = x;
+        y = x;
+        nlu = nlm;
+        nll = nlm;
+        lsp = false;
+        lsm = false;
+
+        //  Increment entry in row L, column M.
+        while (!lsp) {
+            j = (id - nlu) * (ia - nlu);
+
+            if (j == 0) {
+                lsp = true;
+            } else {
+                nlu += 1;
+                n_steps++;
+                xu = xu * static_cast<double>(j) / static_cast<double>(nlu * (ii + nlu));
+                sumprb += xu;
+
+                if (r <= sumprb) {
+                    return finish(nlu, Stat::walk_accepts);
+                }
+            }
+
+            //  Decrement the entry in row L, column M.
+            while (!lsm) {
+                j = nll * (ii + nll);
+
+                if (j == 0) {
+                    lsm = true;
+                    break;
+                }
+
+                nll -= 1;
+                n_steps++;
+                y = y * static_cast<double>(j) / static_cast<double>((id - nll) * (ia - nll));
+                sumprb += y;
+
+                if (r <= sumprb) {
+                    return finish(nll, Stat::walk_accepts);
+                }
+
+                if (!lsp) {
+                    break;
+                }
+            }
+        }
+
+        n_restarts++;
+        r = sumprb * uni_dist(rng);
+    }
+}  // rcont2_walk
+
+/* ModeWalk draws the entry of a cell by walking outwards from the mode.
+ *
+ *   The default cell strategy of `rcont2`, a cell strategy provides
+ *   `draw(ia, id, ie, factorial_table, rng)` which returns a draw from
+ *   the conditional distribution of the cell given the remaining row sum
+ *   `ia`, the remaining column sum `id` and the remaining total `ie`.
+ *   The uniforms are drawn by `Uniform`, `OpenUniform` or a `UniformBuffer`.
+ */
+template<typename Uniform = OpenUniform>
+struct BasicModeWalk {
+    Uniform uni_dist;
+
+    template<typename T, typename Table, isInt<T> = true>
+    inline T draw(const T ia, const T id, const T ie, const Table& factorial_table, pcg64_dxsm& rng) {
+        PhaseTimer timer(Stat::mode_ns);
+        const T ic = ie - id;
+        const T ib = ie - ia;
+        const T ii = ib - id;
+
+        //  Generate a pseudo-random number.
+        const double r = uni_dist(rng);
+        count_stat(Stat::rng_draws);
+
+        //  Compute the conditional expected value of MATRIX(L,M).
+        // the product is rounded as the exact integer product would be but cannot overflow
+        const T nlm = static_cast<T>(
+            static_cast<double>(ia) * static_cast<double>(id) / static_cast<double>(ie) + 0.5
+        );
+        const T iap = ia + 1;
+        const T idp = id + 1;
+        const T igp = idp - nlm;
+        const T ihp = iap - nlm;
+        const T nlmp = nlm + 1;
+        const T iip = ii + nlmp;
+        const double x = std::exp(
+            factorial_table[iap - 1] + factorial_table[ib] + factorial_table[ic] + factorial_table[idp - 1]
+            - factorial_table[ie] - factorial_table[nlmp - 1] - factorial_table[igp - 1]
+            - factorial_table[ihp - 1] - factorial_table[iip - 1]);
+        timer.stop();
+
+        // promote to 64 bits only for the cells whose products could overflow `T`
+        if (sizeof(T) < sizeof(int64_t) && static_cast<int64_t>(ie) > max_walk_total<T>()) {
+            return static_cast<T>(rcont2_walk<int64_t>(
+                static_cast<int64_t>(ia), static_cast<int64_t>(id), static_cast<int64_t>(ii),
+                static_cast<int64_t>(nlm), x, r, rng, uni_dist
+            ));
+        }
+        return rcont2_walk<T>(ia, id, ii, nlm, x, r, rng, uni_dist);
+    }
+};  // BasicModeWalk
+
+typedef BasicModeWalk<> ModeWalk;
+
+/* StridedSink stores the cells of a table in dense memory.
+ *
+ *   Sink for `rcont2_sink`, cell (i, j) is stored at
+ *   `result[i * row_stride + j * col_stride]`.
+ */
+template<typename S, isInt<S> = true>
+struct StridedSink {
+    S* result;
+    size_t row_stride;
+    size_t col_stride;
+
+    template<typename T>
+    inline void set(const T l, const T m, const T value) {
+        result[l * row_stride + m * col_stride] = static_cast<S>(value);
+    }
+
+    /* Cells [m, end) of row `l` are zero. */
+    template<typename T>
+    inline void zeros(const T l, const T m, const T end) {
+        for (T j = m; j < end; j++) {
+            result[l * row_stride + j * col_stride] = 0;
+        }
+    }
+};  // StridedSink
+
+/* Extent of a table dimension that is only known at run time. */
+constexpr int dynamic_extent = 0;
+
+template<int N>
+using extent = std::integral_constant<int, N>;
+
 /* rcont2 constructs a random two-way contingency table with given sums.
  *
- *   It is possible to specify row and column sum vectors which
- *   correspond to no table at all.  As far as I can see, this routine does
- *   not detect such a case.
+ *   Kernel of `rcont2_sink` for tables with `R` rows and `C` columns,
+ *   either can be `dynamic_extent` in which case `n_rows` or `n_cols` is
+ *   used. The fixed extents turn the loops into straight-line code, a 2x2
+ *   table is a single draw, and without a dynamic number of columns the
+ *   scratch space lives on the stack and `jwork` is not used.
+ *   The tables are identical to those of the dynamic kernel.
  *
  * Parameters
  * ----------
- * n_row : number of rows in the table, must be >= 2;
- * n_col : number of columns in the table, must be >= 2;
- * n_total : the sum of the column or row sums
- * n_row_sums : the row sums, must be > 0;
- * n_col_sums : the column sums, must be > 0;
- * result : pointer to the memory where the table will be stored,
- *          must be of size [n_row * n_col] and is expected to be C-contiguous;
- * factorial_table : pointer to table containing the log factorials,
- *                   can be created using `patefield::create_factorial_table`
- *  rng : instantiated random number generator of PCG RNG family
+ * n_rows : number of rows in the table, must be `R` unless that is dynamic
+ * n_cols : number of columns in the table, must be `C` unless that is dynamic
+ * jwork : scratch space of size [n_col], only used when `C` is dynamic
+ *
+ * See `rcont2_sink` for the other parameters.
  */
-template<typename T, isInt<T> = true>
-void rcont2(
-    const T n_row,
-    const T n_col,
+template<int R, int C, typename T, typename CellStrategy, typename Table, typename Sink, isInt<T> = true>
+inline void rcont2_fixed(
+    const T n_rows,
+    const T n_cols,
     const T n_total,
     const T* n_row_sums,
     const T* n_col_sums,
-    T* result,
-    double* factorial_table,
-    pcg64_dxsm& rng
+    Sink& sink,
+    const Table& factorial_table,
+    pcg64_dxsm& rng,
+    int64_t* jwork,
+    CellStrategy& cell
 ) {
-    bool done1;
-    bool done2;
-    bool lsm;
-    bool lsp;
+    // the extents are constants for the fixed shapes, the loops below are unrolled
+    const T n_row = R == dynamic_extent ? n_rows : static_cast<T>(R);
+    const T n_col = C == dynamic_extent ? n_cols : static_cast<T>(C);
+    // tables with a fixed number of columns keep the column sums on the stack
+    int64_t local_jwork[C == dynamic_extent ? 1 : C];
+    if (C != dynamic_extent) {
+        jwork = local_jwork;
+    }
     T i;
     T ia;
-    T iap;
-    T ib;
+    // set by the first cell, n_col >= 2
+    T ib = 0;
     T ic;
     T id;
-    T idp;
     T ie;
-    T igp;
-    T ihp;
-    T ii;
-    T iip;
     T j;
     T jc;
     T l;
     T m;
-    T nll;
     T nlm;
-    T nlmp;
     T n_row_sumsl;
-    double r;
-    double sumprb;
-    double x;
-    double y;
-
-    // the distribution should be a uniform over the open set (0, 1)
-    // uniform_real_distribution is [a, b)
-    std::uniform_real_distribution<double> uni_dist(0.0 + std::numeric_limits<double>::epsilon(), 1.0);
+    uint64_t n_cells = 0;
+    uint64_t n_early_exits = 0;
 
     //  Construct a random matrix.
-    std::unique_ptr<int64_t[]> jwork_arr(new int64_t[n_col]);
-    int64_t* jwork = jwork_arr.get();
-
     for (i = 0; i < n_col - 1; i++) {
         jwork[i] = n_col_sums[i];
     }
@@ -128,118 +342,202 @@ void rcont2(
             ie = ic;
             ic = ic - id;
             ib = ie - ia;
-            ii = ib - id;
 
             //  Test for zero entries in matrix.
             if (ie == 0) {
                 ia = 0;
-                for (j = m; j < n_col; j++) {
-                    result[l + j * n_row] = 0;
-                }
+                sink.zeros(l, m, static_cast<T>(n_col - 1));
+                n_early_exits++;
                 break;
             }
 
-            //  Generate a pseudo-random number.
-            r = uni_dist(rng);
-
-            //  Compute the conditional expected value of MATRIX(L,M).
-            done1 = false;
-
-            for (;;) {
-                nlm = static_cast<int>(static_cast<double>(ia * id) / static_cast<double>(ie) + 0.5);
-                iap = ia + 1;
-                idp = id + 1;
-                igp = idp - nlm;
-                ihp = iap - nlm;
-                nlmp = nlm + 1;
-                iip = ii + nlmp;
-                x = std::exp(
-                    factorial_table[iap - 1] + factorial_table[ib] + factorial_table[ic] + factorial_table[idp - 1]
-                    - factorial_table[ie] - factorial_table[nlmp - 1] - factorial_table[igp - 1]
-                    - factorial_table[ihp - 1] - factorial_table[iip - 1]);
-
-                if (r <= x) {
-                    break;
-                }
-
-                sumprb = x;
-                y = x;
-                nll = nlm;
-                lsp = false;
-                lsm = false;
-
-                //  Increment entry in row L, column M.
-                while (!lsp) {
-                    j = (id - nlm) * (ia - nlm);
-
-                    if (j == 0) {
-                        lsp = true;
-                    } else {
-                        nlm += 1;
-                        x = x * static_cast<double>(j) / static_cast<double>(nlm * (ii + nlm));
-                        sumprb += x;
-
-                        if (r <= sumprb) {
-                            done1 = true;
-                            break;
-                        }
-                    }
-
-                    done2 = false;
-
-                    //  Decrement the entry in row L, column M.
-                    while (!lsm) {
-                        j = nll * (ii + nll);
-
-                        if (j == 0) {
-                            lsm = true;
-                            break;
-                        }
-
-                        nll -= 1;
-                        y = y * static_cast<double>(j) / static_cast<double>((id - nll) * (ia - nll));
-                        sumprb += y;
-
-                        if (r <= sumprb) {
-                            nlm = nll;
-                            done2 = true;
-                            break;
-                        }
-
-                        if (!lsp) {
-                            break;
-                        }
-                    }
-
-                    if (done2) {
-                        break;
-                    }
-                }
-
-                if (done1) {
-                    break;
-                }
-
-                if (done2) {
-                    break;
-                }
+            nlm = cell.template draw<T>(ia, id, ie, factorial_table, rng);
+            n_cells++;
 
-                r = sumprb * uni_dist(rng);
-            }
-
-            result[l + m * n_row] = nlm;
+            sink.set(l, m, nlm);
             ia -= nlm;
             jwork[m] = jwork[m] - nlm;
         }
-        result[l + (n_col - 1) * n_row] = ia;
+        sink.set(l, static_cast<T>(n_col - 1), ia);
     }
     //  Compute the last row.
     for (j = 0; j < n_col - 1; j++) {
-        result[n_row - 1 + j * n_row] = jwork[j];
+        sink.set(static_cast<T>(n_row - 1), j, static_cast<T>(jwork[j]));
     }
-    result[n_row - 1 + (n_col - 1) * n_row] = ib - result[n_row - 1 + (n_col - 2) * n_row];
+    sink.set(static_cast<T>(n_row - 1), static_cast<T>(n_col - 1), static_cast<T>(ib - jwork[n_col - 2]));
 
+    count_stat(Stat::tables);
+    count_stat(Stat::cells, n_cells);
+    count_stat(Stat::early_exits, n_early_exits);
     return;
+}  // rcont2_fixed
+
+/* rcont2 constructs a random two-way contingency table with given sums.
+ *
+ *   It is possible to specify row and column sum vectors which
+ *   correspond to no table at all.  As far as I can see, this routine does
+ *   not detect such a case.
+ *
+ *   The cells are passed to `sink` row by row, in order of the columns and
+ *   every row ends with its last column. `sink.set(l, m, value)` receives
+ *   cell (l, m) and `sink.zeros(l, m, end)` signals that the cells [m, end)
+ *   of row `l` are zero, see `StridedSink`.
+ *   Tables of shape 2x2, 2x3, 3x2 and 3x3, with two rows or with two
+ *   columns are dispatched to the kernels of `rcont2_fixed`.
+ *
+ * Parameters
+ * ----------
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_total : the sum of the column or row sums
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * sink : receives the cells of the table
+ * factorial_table : pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`,
+ *                   or a `LogFactorial` view
+ * rng : instantiated random number generator of PCG RNG family
+ * jwork : scratch space of size [n_col], its contents are overwritten
+ * cell : the strategy used to draw the entry of each cell, see `ModeWalk`
+ */
+template<typename T, typename CellStrategy, typename Table, typename Sink, isInt<T> = true>
+void rcont2_sink(
+    const T n_row,
+    const T n_col,
+    const T n_total,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    Sink& sink,
+    const Table& factorial_table,
+    pcg64_dxsm& rng,
+    int64_t* jwork,
+    CellStrategy& cell
+) {
+    auto fixed = [&](auto rows, auto cols) {
+        rcont2_fixed<decltype(rows)::value, decltype(cols)::value, T, CellStrategy>(
+            n_row, n_col, n_total, n_row_sums, n_col_sums, sink, factorial_table, rng, jwork, cell
+        );
+    };
+    if (n_row == 2) {
+        if (n_col == 2) {
+            fixed(extent<2>(), extent<2>());
+        } else if (n_col == 3) {
+            fixed(extent<2>(), extent<3>());
+        } else {
+            fixed(extent<2>(), extent<dynamic_extent>());
+        }
+    } else if (n_row == 3 && n_col == 3) {
+        fixed(extent<3>(), extent<3>());
+    } else if (n_col == 2) {
+        if (n_row == 3) {
+            fixed(extent<3>(), extent<2>());
+        } else {
+            fixed(extent<dynamic_extent>(), extent<2>());
+        }
+    } else {
+        fixed(extent<dynamic_extent>(), extent<dynamic_extent>());
+    }
+}  // rcont2_sink
+
+/* rcont2 constructs a random two-way contingency table with given sums.
+ *
+ * Overload of `rcont2_sink` storing the table in dense memory.
+ *
+ * Parameters
+ * ----------
+ * result : pointer to the memory where the table will be stored,
+ *          cell (i, j) is stored at `result[i * row_stride + j * col_stride]`;
+ *          the storage type `S` can be narrower than `T` which is used for the
+ *          arithmetic, every cell must fit in `S`;
+ * row_stride : distance between the rows of the table
+ * col_stride : distance between the columns of the table, the cells of a row
+ *              are written in order so `col_stride = 1` writes sequentially
+ *
+ * See `rcont2_sink` for the other parameters.
+ */
+template<typename T, typename CellStrategy, typename Table, typename S = T, isInt<T> = true, isInt<S> = true>
+inline void rcont2_strided(
+    const T n_row,
+    const T n_col,
+    const T n_total,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    S* result,
+    const size_t row_stride,
+    const size_t col_stride,
+    const Table& factorial_table,
+    pcg64_dxsm& rng,
+    int64_t* jwork,
+    CellStrategy& cell
+) {
+    StridedSink<S> sink{result, row_stride, col_stride};
+    rcont2_sink<T, CellStrategy>(
+        n_row, n_col, n_total, n_row_sums, n_col_sums, sink, factorial_table, rng, jwork, cell
+    );
+}  // rcont2_strided
+
+/* rcont2 constructs a random two-way contingency table with given sums.
+ *
+ * Overload of `rcont2_strided` writing the table column-major, i.e.
+ * cell (i, j) at `result[i + j * n_row]`.
+ */
+template<typename T, typename CellStrategy, typename Table, isInt<T> = true>
+inline void rcont2(
+    const T n_row,
+    const T n_col,
+    const T n_total,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    T* result,
+    const Table& factorial_table,
+    pcg64_dxsm& rng,
+    int64_t* jwork,
+    CellStrategy& cell
+) {
+    rcont2_strided<T, CellStrategy>(
+        n_row, n_col, n_total, n_row_sums, n_col_sums, result, 1, static_cast<size_t>(n_row), factorial_table, rng,
+        jwork, cell
+    );
+}  // rcont2
+
+/* rcont2 constructs a random two-way contingency table with given sums.
+ *
+ * Overload of `rcont2` using the `ModeWalk` cell strategy.
+ */
+template<typename T, typename Table, isInt<T> = true>
+inline void rcont2(
+    const T n_row,
+    const T n_col,
+    const T n_total,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    T* result,
+    const Table& factorial_table,
+    pcg64_dxsm& rng,
+    int64_t* jwork
+) {
+    ModeWalk cell;
+    rcont2<T, ModeWalk>(n_row, n_col, n_total, n_row_sums, n_col_sums, result, factorial_table, rng, jwork, cell);
+}  // rcont2
+
+/* rcont2 constructs a random two-way contingency table with given sums.
+ *
+ * Convenience overload of `rcont2` that allocates the scratch space,
+ * prefer the overload taking `jwork` when generating many tables.
+ */
+template<typename T, typename Table, isInt<T> = true>
+inline void rcont2(
+    const T n_row,
+    const T n_col,
+    const T n_total,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    T* result,
+    const Table& factorial_table,
+    pcg64_dxsm& rng
+) {
+    std::unique_ptr<int64_t[]> jwork(new int64_t[n_col]);
+    rcont2<T>(n_row, n_col, n_total, n_row_sums, n_col_sums, result, factorial_table, rng, jwork.get());
 }  // rcont2
 
 }  // namespace details
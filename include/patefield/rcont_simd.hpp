@@ -0,0 +1,416 @@
+/* rcont_simd.hpp -- Patefield algorithm over multiple tables in lockstep.
+ * Copyright 2022 R. Urlus
+ *
+ * Generates a batch of tables that share the same marginals where each
+ * table occupies a SIMD lane. The probability of the mode of each
+ * cell, nine factorial table lookups and an exponential, is computed for
+ * all lanes at once, the walk from the mode is performed per lane for
+ * the lanes that did not accept the mode.
+ *
+ * AVX-512F and AVX2 have explicit kernels on x86-64 with GCC or Clang, other
+ * targets use a scalar fallback. The kernels are compiled with target
+ * attributes and selected at run time from the features of the CPU,
+ * independent of the architecture flags of the translation unit, such that
+ * the library and the code including this header share one definition of
+ * every function.
+ */
+
+#ifndef INCLUDE_PATEFIELD_RCONT_SIMD_HPP_
+#define INCLUDE_PATEFIELD_RCONT_SIMD_HPP_
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(PATEFIELD_DISABLE_SIMD_KERNEL)
+#define PATEFIELD_HAS_SIMD_DISPATCH
+#include <immintrin.h>
+#endif
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+#include <patefield/commons.hpp>
+#include <patefield/factorial.hpp>
+#include <patefield/rcont.hpp>
+#include <patefield/stats.hpp>
+#include <patefield/uniform.hpp>
+
+namespace patefield {
+namespace details {
+
+/* Number of tables generated in lockstep by `rcont2_simd`.
+ *
+ *  Fixed independent of the instruction set, the AVX2 kernel handles it as
+ *  two halves. Callers size the scratch space with it and the inline
+ *  functions using it are shared between the library and translation
+ *  units built with other architecture flags, it must be the same in all.
+ */
+constexpr size_t simd_lanes = 8;
+
+/* Number of factorial table lookups for the probability of the mode. */
+constexpr size_t n_mode_terms = 9;
+
+/* Probability of the mode for all lanes, `idx[t][k]` is term `t` of lane `k`. */
+template <size_t W, typename Table>
+inline void lanes_mode_probability_scalar(const Table& table, const int64_t (*idx)[W], double* x) {
+    for (size_t k = 0; k < W; k++) {
+        x[k] = std::exp(
+            table[idx[0][k]] + table[idx[1][k]] + table[idx[2][k]] + table[idx[3][k]]
+            - table[idx[4][k]] - table[idx[5][k]] - table[idx[6][k]]
+            - table[idx[7][k]] - table[idx[8][k]]);
+    }
+}
+
+/* Probability of the mode for all lanes, `idx[t][k]` is term `t` of lane `k`. */
+template <size_t W>
+inline void lanes_mode_probability(const LogFactorial& table, const int64_t (*idx)[W], double* x) {
+    lanes_mode_probability_scalar<W>(table, idx, x);
+}
+
+#if defined(PATEFIELD_HAS_SIMD_DISPATCH)
+
+/* Instruction sets with an explicit kernel. */
+enum class SimdIsa : int { scalar = 0, avx2 = 1, avx512 = 2 };
+
+/* The widest instruction set supported by the CPU and the operating system. */
+inline SimdIsa detect_simd_isa() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SimdIsa::avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdIsa::avx2;
+    }
+    return SimdIsa::scalar;
+}
+
+/* The instruction set of the kernels, detected on first use. */
+inline SimdIsa simd_isa() {
+    static const SimdIsa isa = detect_simd_isa();
+    return isa;
+}
+
+/* All 8 lanes, the masked forms of the intrinsics are used as the unmasked
+ * forms start from an undefined vector which GCC reports as uninitialized.
+ */
+constexpr __mmask8 all_lanes_avx512 = 0xFF;
+
+/* Cephes exp for 8 lanes, relative error close to one ulp. */
+__attribute__((target("avx512f"))) inline __m512d exp_pd_avx512(__m512d x) {
+    const __m512d hi = _mm512_set1_pd(709.78271289338397);
+    const __m512d lo = _mm512_set1_pd(-708.39641853226408);
+    x = _mm512_maskz_max_pd(all_lanes_avx512, _mm512_maskz_min_pd(all_lanes_avx512, x, hi), lo);
+
+    const __m512d fx = _mm512_maskz_roundscale_pd(
+        all_lanes_avx512,
+        _mm512_fmadd_pd(x, _mm512_set1_pd(1.4426950408889634073599), _mm512_set1_pd(0.5)),
+        _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC
+    );
+    x = _mm512_fnmadd_pd(fx, _mm512_set1_pd(6.93145751953125E-1), x);
+    x = _mm512_fnmadd_pd(fx, _mm512_set1_pd(1.42860682030941723212E-6), x);
+
+    const __m512d xx = _mm512_mul_pd(x, x);
+    __m512d px = _mm512_set1_pd(1.26177193074810590878E-4);
+    px = _mm512_fmadd_pd(px, xx, _mm512_set1_pd(3.02994407707441961300E-2));
+    px = _mm512_fmadd_pd(px, xx, _mm512_set1_pd(9.99999999999999999910E-1));
+    px = _mm512_mul_pd(px, x);
+
+    __m512d qx = _mm512_set1_pd(3.00198505138664455042E-6);
+    qx = _mm512_fmadd_pd(qx, xx, _mm512_set1_pd(2.52448340349684104192E-3));
+    qx = _mm512_fmadd_pd(qx, xx, _mm512_set1_pd(2.27265548208155028766E-1));
+    qx = _mm512_fmadd_pd(qx, xx, _mm512_set1_pd(2.00000000000000000009E0));
+
+    x = _mm512_div_pd(px, _mm512_sub_pd(qx, px));
+    x = _mm512_fmadd_pd(x, _mm512_set1_pd(2.0), _mm512_set1_pd(1.0));
+    return _mm512_maskz_scalef_pd(all_lanes_avx512, x, fx);
+}
+
+/* `table[ptr[k]]` for the 8 lanes. */
+__attribute__((target("avx512f"))) inline __m512d gather_pd_avx512(const double* table, const int64_t* ptr) {
+    return _mm512_mask_i64gather_pd(_mm512_setzero_pd(), all_lanes_avx512, _mm512_loadu_si512(ptr), table, 8);
+}
+
+/* Probability of the mode for all lanes using AVX-512F, `W` must be a multiple of 8. */
+template <size_t W>
+__attribute__((target("avx512f"))) inline void lanes_mode_probability_avx512(
+    const double* table, const int64_t (*idx)[W], double* x
+) {
+    for (size_t k = 0; k + 8 <= W; k += 8) {
+        __m512d s = gather_pd_avx512(table, idx[0] + k);
+        for (size_t t = 1; t < 4; t++) {
+            s = _mm512_add_pd(s, gather_pd_avx512(table, idx[t] + k));
+        }
+        for (size_t t = 4; t < n_mode_terms; t++) {
+            s = _mm512_sub_pd(s, gather_pd_avx512(table, idx[t] + k));
+        }
+        _mm512_storeu_pd(x + k, exp_pd_avx512(s));
+    }
+}
+
+/* Cephes exp for 4 lanes, relative error close to one ulp. */
+__attribute__((target("avx2"))) inline __m256d exp_pd_avx2(__m256d x) {
+    const __m256d hi = _mm256_set1_pd(709.78271289338397);
+    const __m256d lo = _mm256_set1_pd(-708.39641853226408);
+    x = _mm256_max_pd(_mm256_min_pd(x, hi), lo);
+
+    const __m256d fx = _mm256_floor_pd(
+        _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634073599)), _mm256_set1_pd(0.5))
+    );
+    x = _mm256_sub_pd(x, _mm256_mul_pd(fx, _mm256_set1_pd(6.93145751953125E-1)));
+    x = _mm256_sub_pd(x, _mm256_mul_pd(fx, _mm256_set1_pd(1.42860682030941723212E-6)));
+
+    const __m256d xx = _mm256_mul_pd(x, x);
+    __m256d px = _mm256_set1_pd(1.26177193074810590878E-4);
+    px = _mm256_add_pd(_mm256_mul_pd(px, xx), _mm256_set1_pd(3.02994407707441961300E-2));
+    px = _mm256_add_pd(_mm256_mul_pd(px, xx), _mm256_set1_pd(9.99999999999999999910E-1));
+    px = _mm256_mul_pd(px, x);
+
+    __m256d qx = _mm256_set1_pd(3.00198505138664455042E-6);
+    qx = _mm256_add_pd(_mm256_mul_pd(qx, xx), _mm256_set1_pd(2.52448340349684104192E-3));
+    qx = _mm256_add_pd(_mm256_mul_pd(qx, xx), _mm256_set1_pd(2.27265548208155028766E-1));
+    qx = _mm256_add_pd(_mm256_mul_pd(qx, xx), _mm256_set1_pd(2.00000000000000000009E0));
+
+    x = _mm256_div_pd(px, _mm256_sub_pd(qx, px));
+    x = _mm256_add_pd(_mm256_add_pd(x, x), _mm256_set1_pd(1.0));
+
+    // scale by 2^fx by adding fx to the exponent bits
+    const __m256i n = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(fx));
+    const __m256i pow2n = _mm256_slli_epi64(_mm256_add_epi64(n, _mm256_set1_epi64x(1023)), 52);
+    return _mm256_mul_pd(x, _mm256_castsi256_pd(pow2n));
+}
+
+__attribute__((target("avx2"))) inline __m256i load_epi64_avx2(const int64_t* ptr) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+}
+
+/* Probability of the mode for all lanes using AVX2, `W` must be a multiple of 4. */
+template <size_t W>
+__attribute__((target("avx2"))) inline void lanes_mode_probability_avx2(
+    const double* table, const int64_t (*idx)[W], double* x
+) {
+    for (size_t k = 0; k + 4 <= W; k += 4) {
+        __m256d s = _mm256_i64gather_pd(table, load_epi64_avx2(idx[0] + k), 8);
+        for (size_t t = 1; t < 4; t++) {
+            s = _mm256_add_pd(s, _mm256_i64gather_pd(table, load_epi64_avx2(idx[t] + k), 8));
+        }
+        for (size_t t = 4; t < n_mode_terms; t++) {
+            s = _mm256_sub_pd(s, _mm256_i64gather_pd(table, load_epi64_avx2(idx[t] + k), 8));
+        }
+        _mm256_storeu_pd(x + k, exp_pd_avx2(s));
+    }
+}
+
+/* Probability of the mode for all lanes, `idx[t][k]` is term `t` of lane `k`. */
+template <size_t W>
+inline void lanes_mode_probability(const double* table, const int64_t (*idx)[W], double* x) {
+    const SimdIsa isa = simd_isa();
+    if (W % 8 == 0 && isa == SimdIsa::avx512) {
+        lanes_mode_probability_avx512<W>(table, idx, x);
+    } else if (W % 4 == 0 && isa != SimdIsa::scalar) {
+        lanes_mode_probability_avx2<W>(table, idx, x);
+    } else {
+        lanes_mode_probability_scalar<W>(table, idx, x);
+    }
+}
+
+#else
+
+/* Probability of the mode for all lanes, `idx[t][k]` is term `t` of lane `k`. */
+template <size_t W>
+inline void lanes_mode_probability(const double* table, const int64_t (*idx)[W], double* x) {
+    lanes_mode_probability_scalar<W>(table, idx, x);
+}
+
+#endif
+
+/* rcont2_simd constructs up to `W` random two-way contingency tables with given sums.
+ *
+ * Parameters
+ * ----------
+ * n_lanes : number of tables to generate, must be <= W
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_total : the sum of the column or row sums
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * results : pointers to the memory where the tables will be stored,
+ *           cell (i, j) is stored at `results[k][i * row_stride + j * col_stride]`;
+ *           the storage type `S` can be narrower than `T`, every cell must fit in `S`;
+ * row_stride : distance between the rows of the tables
+ * col_stride : distance between the columns of the tables
+ * factorial_table : pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`,
+ *                   or a `LogFactorial` view
+ * rngs : pointers to the random number generators, one per lane,
+ *        lanes may share the same generator
+ * jwork : scratch space of size [W * n_col], its contents are overwritten
+ */
+template<
+    typename T, size_t W = simd_lanes, typename Table = const double*, typename S = T, isInt<T> = true,
+    isInt<S> = true>
+void rcont2_simd_strided(
+    const size_t n_lanes,
+    const T n_row,
+    const T n_col,
+    const T n_total,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    S* const* results,
+    const size_t row_stride,
+    const size_t col_stride,
+    const Table& factorial_table,
+    pcg64_dxsm* const* rngs,
+    int64_t* jwork
+) {
+    alignas(64) int64_t ia[W];
+    alignas(64) int64_t ib[W];
+    alignas(64) int64_t ic[W];
+    alignas(64) int64_t id[W];
+    alignas(64) int64_t ii[W];
+    alignas(64) int64_t nlm[W];
+    alignas(64) int64_t idx[n_mode_terms][W];
+    alignas(64) double r[W];
+    alignas(64) double x[W];
+    bool active[W];
+    uint64_t n_cells = 0;
+    uint64_t n_early_exits = 0;
+    uint64_t n_mode_accepts = 0;
+
+    OpenUniform uni_dist;
+
+    // jwork is stored lane-contiguous, column m of lane k is jwork[m * W + k]
+    for (T i = 0; i < n_col - 1; i++) {
+        for (size_t k = 0; k < W; k++) {
+            jwork[i * W + k] = n_col_sums[i];
+        }
+    }
+    for (size_t k = 0; k < W; k++) {
+        ib[k] = 0;
+    }
+
+    int64_t jc = n_total;
+
+    for (T l = 0; l < n_row - 1; l++) {
+        const int64_t n_row_sumsl = n_row_sums[l];
+        for (size_t k = 0; k < W; k++) {
+            ia[k] = n_row_sumsl;
+            ic[k] = jc;
+            active[k] = k < n_lanes;
+        }
+        jc -= n_row_sumsl;
+
+        for (T m = 0; m < n_col - 1; m++) {
+            int64_t* jwork_m = jwork + m * W;
+            bool any_active = false;
+            PhaseTimer timer(Stat::mode_ns);
+            for (size_t k = 0; k < W; k++) {
+                if (!active[k]) {
+                    for (size_t t = 0; t < n_mode_terms; t++) {
+                        idx[t][k] = 0;
+                    }
+                    continue;
+                }
+                id[k] = jwork_m[k];
+                const int64_t ie = ic[k];
+                ic[k] -= id[k];
+                ib[k] = ie - ia[k];
+                ii[k] = ib[k] - id[k];
+
+                //  Test for zero entries in matrix.
+                if (ie == 0) {
+                    active[k] = false;
+                    ia[k] = 0;
+                    n_early_exits++;
+                    for (T j = m; j < n_col; j++) {
+                        results[k][l * row_stride + j * col_stride] = 0;
+                    }
+                    for (size_t t = 0; t < n_mode_terms; t++) {
+                        idx[t][k] = 0;
+                    }
+                    continue;
+                }
+                any_active = true;
+                n_cells++;
+
+                r[k] = uni_dist(*rngs[k]);
+                nlm[k] = static_cast<int64_t>(
+                    static_cast<double>(ia[k] * id[k]) / static_cast<double>(ie) + 0.5
+                );
+                idx[0][k] = ia[k];
+                idx[1][k] = ib[k];
+                idx[2][k] = ic[k];
+                idx[3][k] = id[k];
+                idx[4][k] = ie;
+                idx[5][k] = nlm[k];
+                idx[6][k] = id[k] - nlm[k];
+                idx[7][k] = ia[k] - nlm[k];
+                idx[8][k] = ii[k] + nlm[k];
+            }
+            if (!any_active) {
+                break;
+            }
+
+            lanes_mode_probability<W>(factorial_table, idx, x);
+            timer.stop();
+
+            for (size_t k = 0; k < W; k++) {
+                if (!active[k]) {
+                    continue;
+                }
+                const bool at_mode = r[k] <= x[k];
+                n_mode_accepts += at_mode;
+                const int64_t value = at_mode ? nlm[k] : rcont2_walk<int64_t>(
+                    ia[k], id[k], ii[k], nlm[k], x[k], r[k], *rngs[k], uni_dist
+                );
+                results[k][l * row_stride + m * col_stride] = static_cast<S>(value);
+                ia[k] -= value;
+                jwork_m[k] -= value;
+            }
+        }
+        for (size_t k = 0; k < n_lanes; k++) {
+            results[k][l * row_stride + (n_col - 1) * col_stride] = static_cast<S>(ia[k]);
+        }
+    }
+    //  Compute the last row.
+    for (size_t k = 0; k < n_lanes; k++) {
+        S* last_row = results[k] + (n_row - 1) * row_stride;
+        for (T j = 0; j < n_col - 1; j++) {
+            last_row[j * col_stride] = static_cast<S>(jwork[j * W + k]);
+        }
+        last_row[(n_col - 1) * col_stride] = static_cast<S>(ib[k] - last_row[(n_col - 2) * col_stride]);
+    }
+
+    count_stat(Stat::tables, n_lanes);
+    count_stat(Stat::cells, n_cells);
+    count_stat(Stat::early_exits, n_early_exits);
+    count_stat(Stat::mode_accepts, n_mode_accepts);
+    count_stat(Stat::rng_draws, n_cells);
+}  // rcont2_simd_strided
+
+/* rcont2_simd constructs up to `W` random two-way contingency tables with given sums.
+ *
+ * Overload of `rcont2_simd_strided` using the layout of `rcont2`,
+ * i.e. cell (i, j) at `results[k][i + j * n_row]`.
+ */
+template<typename T, size_t W = simd_lanes, typename Table = const double*, isInt<T> = true>
+inline void rcont2_simd(
+    const size_t n_lanes,
+    const T n_row,
+    const T n_col,
+    const T n_total,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    T* const* results,
+    const Table& factorial_table,
+    pcg64_dxsm* const* rngs,
+    int64_t* jwork
+) {
+    rcont2_simd_strided<T, W>(
+        n_lanes, n_row, n_col, n_total, n_row_sums, n_col_sums, results, 1, static_cast<size_t>(n_row),
+        factorial_table, rngs, jwork
+    );
+}  // rcont2_simd
+
+}  // namespace details
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_RCONT_SIMD_HPP_
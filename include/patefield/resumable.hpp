@@ -0,0 +1,240 @@
+/* resumable.hpp -- Generate tables in numbered chunks that can be resumed.
+ * Copyright 2022 R. Urlus
+ *
+ * The generator draws table `i` from the stream given by the seed and `i`,
+ * the reproducible mode of `generate_contingency_tables`. Together with the
+ * number of finished chunks this fixes the state of every stream that is
+ * still to be drawn, a checkpoint therefore only stores the seed and the
+ * cursor and a resumed run produces exactly the tables of an uninterrupted
+ * one.
+ */
+
+#ifndef INCLUDE_PATEFIELD_RESUMABLE_HPP_
+#define INCLUDE_PATEFIELD_RESUMABLE_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <patefield/commons.hpp>
+#include <patefield/factorial.hpp>
+#include <patefield/parallel.hpp>
+#include <patefield/patefield.hpp>
+
+namespace patefield {
+
+/* State of a `ResumableGenerator`.
+ *
+ * seed : the seed of the table streams
+ * n_tables : total number of tables
+ * chunk_size : number of tables per chunk
+ * n_row : number of rows of a table
+ * n_col : number of columns of a table
+ * marginals_hash : hash of the row and column sums
+ * next_chunk : index of the first chunk that has not been finished
+ */
+struct Checkpoint {
+    uint64_t seed = 0;
+    uint64_t n_tables = 0;
+    uint64_t chunk_size = 0;
+    int64_t n_row = 0;
+    int64_t n_col = 0;
+    uint64_t marginals_hash = 0;
+    uint64_t next_chunk = 0;
+
+    /* Serialize to a single line of text. */
+    std::string to_string() const {
+        std::ostringstream out;
+        out << "patefield-checkpoint 1 " << seed << ' ' << n_tables << ' ' << chunk_size << ' ' << n_row << ' '
+            << n_col << ' ' << marginals_hash << ' ' << next_chunk;
+        return out.str();
+    }
+
+    /* Parse the output of `to_string`. */
+    static Checkpoint from_string(const std::string& text) {
+        std::istringstream in(text);
+        std::string magic;
+        int version = 0;
+        Checkpoint checkpoint;
+        in >> magic >> version >> checkpoint.seed >> checkpoint.n_tables >> checkpoint.chunk_size
+            >> checkpoint.n_row >> checkpoint.n_col >> checkpoint.marginals_hash >> checkpoint.next_chunk;
+        if (in.fail() || magic != "patefield-checkpoint" || version != 1) {
+            throw InputError("patefield: invalid checkpoint.\n");
+        }
+        return checkpoint;
+    }
+};  // Checkpoint
+
+namespace details {
+
+/* FNV-1a hash of the row and column sums. */
+template<typename T, isInt<T> = true>
+inline uint64_t hash_marginals(const T n_row, const T n_col, const T* n_row_sums, const T* n_col_sums) {
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const T value) {
+        uint64_t v = static_cast<uint64_t>(static_cast<int64_t>(value));
+        for (int k = 0; k < 8; k++) {
+            hash = (hash ^ (v & 0xFF)) * 1099511628211ULL;
+            v >>= 8;
+        }
+    };
+    for (T i = 0; i < n_row; i++) mix(n_row_sums[i]);
+    for (T j = 0; j < n_col; j++) mix(n_col_sums[j]);
+    return hash;
+}  // hash_marginals
+
+}  // namespace details
+
+/* Generator of `n_tables` tables in chunks of `chunk_size` that can be resumed.
+ *
+ *  The chunks are generated in order by `next`, chunk `c` holds the tables
+ *  [c * chunk_size, min((c + 1) * chunk_size, n_tables)). After a chunk has
+ *  been stored `checkpoint()` returns the state needed to continue after it,
+ *  a generator constructed from that checkpoint continues with the next
+ *  chunk. The tables are those of `generate_contingency_tables` with
+ *  `reproducible = true`, independent of the interruptions, `n_threads`
+ *  and `kernel`.
+ *
+ * Parameters
+ * ----------
+ * n_tables : number of tables to generate
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * chunk_size : number of tables per chunk
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`
+ *        and stored in the checkpoint.
+ * n_threads : optional, default = 1, the number of threads used to generate
+ *             a chunk
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables
+ */
+template<typename T, isInt<T> = true>
+class ResumableGenerator {
+    T n_row_;
+    T n_col_;
+    const T* n_row_sums_;
+    const T* n_col_sums_;
+    int64_t n_total_;
+    size_t n_threads_;
+    double* factorial_table_;
+    Kernel kernel_;
+    Checkpoint state_;
+
+ public:
+    ResumableGenerator(
+        const size_t n_tables,
+        const T n_row,
+        const T n_col,
+        const T* n_row_sums,
+        const T* n_col_sums,
+        const size_t chunk_size,
+        const uint64_t seed = 0,
+        const size_t n_threads = 1,
+        double* factorial_table = nullptr,
+        const Kernel kernel = Kernel::scalar
+    ) :
+        n_row_{n_row},
+        n_col_{n_col},
+        n_row_sums_{n_row_sums},
+        n_col_sums_{n_col_sums},
+        n_total_{details::check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums)},
+        n_threads_{n_threads},
+        factorial_table_{factorial_table},
+        kernel_{kernel} {
+        if (chunk_size == 0) {
+            throw InputError("patefield: chunk_size must be positive.\n");
+        }
+        state_.seed = details::resolve_seed(seed);
+        state_.n_tables = n_tables;
+        state_.chunk_size = chunk_size;
+        state_.n_row = static_cast<int64_t>(n_row);
+        state_.n_col = static_cast<int64_t>(n_col);
+        state_.marginals_hash = details::hash_marginals<T>(n_row, n_col, n_row_sums, n_col_sums);
+    }
+
+    /* Resume from `checkpoint`, the marginals must be those of the interrupted run. */
+    ResumableGenerator(
+        const Checkpoint& checkpoint,
+        const T* n_row_sums,
+        const T* n_col_sums,
+        const size_t n_threads = 1,
+        double* factorial_table = nullptr,
+        const Kernel kernel = Kernel::scalar
+    ) :
+        ResumableGenerator(
+            checkpoint.n_tables, static_cast<T>(checkpoint.n_row), static_cast<T>(checkpoint.n_col), n_row_sums,
+            n_col_sums, checkpoint.chunk_size, checkpoint.seed, n_threads, factorial_table, kernel
+        ) {
+        if (state_.marginals_hash != checkpoint.marginals_hash) {
+            throw InputError("patefield: marginals do not match those of the checkpoint.\n");
+        }
+        if (checkpoint.next_chunk > n_chunks()) {
+            throw InputError("patefield: checkpoint is beyond the last chunk.\n");
+        }
+        state_.next_chunk = checkpoint.next_chunk;
+    }
+
+    /* Number of chunks. */
+    size_t n_chunks() const {
+        return static_cast<size_t>((state_.n_tables + state_.chunk_size - 1) / state_.chunk_size);
+    }
+
+    /* Index of the chunk generated by the next call of `next`. */
+    size_t next_chunk() const { return static_cast<size_t>(state_.next_chunk); }
+
+    /* True when all chunks have been generated. */
+    bool done() const { return next_chunk() >= n_chunks(); }
+
+    /* Number of tables in chunk `chunk`. */
+    size_t chunk_tables(const size_t chunk) const {
+        const uint64_t first = chunk * state_.chunk_size;
+        return first >= state_.n_tables ? 0 : static_cast<size_t>(std::min(state_.chunk_size, state_.n_tables - first));
+    }
+
+    /* The state after the chunks generated so far. */
+    const Checkpoint& checkpoint() const { return state_; }
+
+    /* Generate the next chunk into `result`.
+     *
+     * Parameters
+     * ----------
+     * result : pointer to memory of size [chunk_tables(next_chunk()) * n_row * n_col],
+     *          the tables are stored as in `generate_contingency_tables`
+     *
+     *  Returns
+     *  -------
+     *  chunk : the index of the generated chunk
+     */
+    size_t next(T* result) {
+        if (done()) {
+            throw InputError("patefield: all chunks have been generated.\n");
+        }
+        const size_t chunk = next_chunk();
+        const size_t first = chunk * static_cast<size_t>(state_.chunk_size);
+        const size_t n = chunk_tables(chunk);
+        const size_t block_size = static_cast<size_t>(n_row_) * static_cast<size_t>(n_col_);
+        details::with_factorial_table(factorial_table_, n_total_, [&](const auto& table) {
+            details::parallel_blocks(n_threads_, n, [&](const size_t, const size_t begin, const size_t end) {
+                std::unique_ptr<int64_t[]> jwork(new int64_t[details::simd_lanes * static_cast<size_t>(n_col_)]);
+                details::generate_table_range<T>(
+                    first + begin, end - begin, n_row_, n_col_, n_row_sums_, n_col_sums_, n_total_, state_.seed,
+                    table, result + begin * block_size, kernel_, jwork.get()
+                );
+            });
+        });
+        state_.next_chunk++;
+        return chunk;
+    }
+};  // ResumableGenerator
+
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_RESUMABLE_HPP_
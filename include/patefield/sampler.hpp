@@ -0,0 +1,156 @@
+/* sampler.hpp -- Reusable Patefield sampler.
+ * Copyright 2022 R. Urlus
+ */
+
+#ifndef INCLUDE_PATEFIELD_SAMPLER_HPP_
+#define INCLUDE_PATEFIELD_SAMPLER_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <patefield/cdf_cache.hpp>
+#include <patefield/commons.hpp>
+#include <patefield/factorial.hpp>
+#include <patefield/hypergeometric.hpp>
+#include <patefield/patefield.hpp>
+#include <patefield/rcont.hpp>
+
+namespace patefield {
+
+/* Sampler for random two-way contingency tables with fixed sums.
+ *
+ *  The marginals are validated once at construction and the
+ *  factorial table, scratch space and random number generator
+ *  are kept between calls. Generating tables through `sample`
+ *  and `sample_n` does not allocate.
+ *
+ * Parameters
+ * ----------
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   of at least size [n_total + 1], not owned by the sampler.
+ *                   Otherwise the process-wide factorial table is used.
+ *
+ * The strategy used to draw the cells is set with `CellStrategy`, e.g.
+ * `details::ModeWalk` (default) or `details::Hrua` for tables with large totals.
+ */
+template<typename T, typename CellStrategy = details::ModeWalk, isInt<T> = true>
+class Sampler {
+    T n_row_;
+    T n_col_;
+    int64_t n_total_;
+    size_t block_size_;
+    std::vector<T> n_row_sums_;
+    std::vector<T> n_col_sums_;
+    details::LogFactorial factorials_;
+    std::unique_ptr<int64_t[]> jwork_;
+    pcg64_dxsm rng_;
+    CellStrategy cell_;
+    std::unique_ptr<details::CdfCache> cache_;
+    std::unique_ptr<details::CachedCdf> cached_cell_;
+
+ public:
+    Sampler(
+        const T n_row,
+        const T n_col,
+        const T* n_row_sums,
+        const T* n_col_sums,
+        const uint64_t seed = 0,
+        const double* factorial_table = nullptr
+    ) :
+        n_row_{n_row},
+        n_col_{n_col},
+        n_total_{details::check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums)},
+        block_size_{static_cast<size_t>(n_row) * static_cast<size_t>(n_col)},
+        n_row_sums_(n_row_sums, n_row_sums + n_row),
+        n_col_sums_(n_col_sums, n_col_sums + n_col),
+        factorials_{
+            factorial_table ? details::LogFactorial(factorial_table, n_total_)
+                            : details::shared_log_factorials(n_total_)
+        },
+        jwork_{new int64_t[n_col]} {
+        set_seed(seed);
+    }
+
+    /* Reseed the random number generator, seed == 0 draws a seed as `generate_contingency_tables`. */
+    void set_seed(const uint64_t seed) {
+        rng_.seed(details::resolve_seed(seed));
+    }
+
+    /* Memoize the conditional distributions of the cells.
+     *
+     * Cells are drawn by inversion of a cached CDF keyed on the remaining
+     * row sum, column sum and total. The cache uses at most `memory_budget`
+     * bytes and evicts the least recently used distribution.
+     */
+    void enable_cache(const size_t memory_budget) {
+        cache_.reset(new details::CdfCache(memory_budget));
+        cached_cell_.reset(new details::CachedCdf(cache_.get()));
+    }
+
+    void disable_cache() {
+        cached_cell_.reset();
+        cache_.reset();
+    }
+
+    /* The counters of the cache, all zero when the cache is not enabled. */
+    CacheStats cache_stats() const {
+        return cache_ ? cache_->stats() : CacheStats();
+    }
+
+    /* Generate a table into `result` which must be of size [n_row * n_col] */
+    T* sample(T* result) {
+        if (factorials_.is_dense(n_total_)) {
+            sample_with(factorials_.data(), result);
+        } else {
+            sample_with(factorials_, result);
+        }
+        return result;
+    }
+
+    /* Generate `n_tables` tables into `result` which must be of size
+     * [n_tables * n_row * n_col], table `i` starts at `i * n_row * n_col`.
+     */
+    T* sample_n(const size_t n_tables, T* result) {
+        for (size_t i = 0; i < n_tables; i++) {
+            sample(result + (i * block_size_));
+        }
+        return result;
+    }
+
+    T n_row() const { return n_row_; }
+    T n_col() const { return n_col_; }
+    int64_t n_total() const { return n_total_; }
+    size_t block_size() const { return block_size_; }
+    const T* n_row_sums() const { return n_row_sums_.data(); }
+    const T* n_col_sums() const { return n_col_sums_.data(); }
+    const details::LogFactorial& log_factorials() const { return factorials_; }
+    pcg64_dxsm& rng() { return rng_; }
+    CellStrategy& cell_strategy() { return cell_; }
+
+ private:
+    template<typename Table>
+    void sample_with(const Table& factorial_table, T* result) {
+        if (cached_cell_) {
+            details::rcont2<T, details::CachedCdf>(
+                n_row_, n_col_, n_total_, n_row_sums_.data(), n_col_sums_.data(), result, factorial_table, rng_,
+                jwork_.get(), *cached_cell_
+            );
+        } else {
+            details::rcont2<T, CellStrategy>(
+                n_row_, n_col_, n_total_, n_row_sums_.data(), n_col_sums_.data(), result, factorial_table, rng_,
+                jwork_.get(), cell_
+            );
+        }
+    }
+};  // Sampler
+
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_SAMPLER_HPP_
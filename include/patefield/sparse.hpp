@@ -0,0 +1,276 @@
+/* sparse.hpp -- Generate tables in compressed sparse row format.
+ * Copyright 2022 R. Urlus
+ *
+ * For skewed marginals most cells of a table are zero. The generator below
+ * passes the cells of `rcont2` straight into CSR arrays, zero cells and the
+ * zero runs after a row has been exhausted are never stored.
+ */
+
+#ifndef INCLUDE_PATEFIELD_SPARSE_HPP_
+#define INCLUDE_PATEFIELD_SPARSE_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <patefield/commons.hpp>
+#include <patefield/factorial.hpp>
+#include <patefield/parallel.hpp>
+#include <patefield/patefield.hpp>
+#include <patefield/rcont.hpp>
+
+namespace patefield {
+
+/* Batch of tables in compressed sparse row format.
+ *
+ *  The batch is a single CSR matrix of shape [n_tables * n_row, n_col],
+ *  row i of table t is row `t * n_row + i`. The non-zero cells of row r
+ *  are `values[k]` at column `indices[k]` for k in [indptr[r], indptr[r + 1]),
+ *  the columns of a row are sorted.
+ *
+ * n_tables : number of tables
+ * n_row : number of rows of a table
+ * n_col : number of columns of a table
+ * indptr : offsets of the rows, of size [n_tables * n_row + 1]
+ * indices : column of each non-zero cell
+ * values : the non-zero cells
+ */
+template<typename T, isInt<T> = true>
+struct SparseTables {
+    size_t n_tables = 0;
+    T n_row = 0;
+    T n_col = 0;
+    std::vector<int64_t> indptr;
+    std::vector<T> indices;
+    std::vector<T> values;
+
+    /* Number of stored cells. */
+    size_t nnz() const { return values.size(); }
+
+    /* Write table `index` into `result` of size [n_row * n_col] using the layout of `rcont2`. */
+    T* to_dense(const size_t index, T* result) const {
+        std::fill(result, result + static_cast<size_t>(n_row) * static_cast<size_t>(n_col), 0);
+        for (T i = 0; i < n_row; i++) {
+            const size_t r = index * static_cast<size_t>(n_row) + static_cast<size_t>(i);
+            for (int64_t k = indptr[r]; k < indptr[r + 1]; k++) {
+                result[i + indices[k] * static_cast<size_t>(n_row)] = values[k];
+            }
+        }
+        return result;
+    }
+};  // SparseTables
+
+namespace details {
+
+/* CsrSink stores the non-zero cells of tables in CSR arrays.
+ *
+ *   Sink for `rcont2_sink`, `indptr` receives the end of every row.
+ */
+template<typename T, isInt<T> = true>
+struct CsrSink {
+    std::vector<int64_t>& indptr;
+    std::vector<T>& indices;
+    std::vector<T>& values;
+    T last_col;
+
+    inline void set(const T, const T m, const T value) {
+        if (value != 0) {
+            indices.push_back(m);
+            values.push_back(value);
+        }
+        // every row ends with its last column
+        if (m == last_col) {
+            indptr.push_back(static_cast<int64_t>(values.size()));
+        }
+    }
+
+    inline void zeros(const T, const T, const T) {}
+};  // CsrSink
+
+template<typename T, typename Table, isInt<T> = true>
+inline void generate_sparse_tables_impl(
+    SparseTables<T>& tables,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    const Table& factorial_table,
+    const bool reproducible
+) {
+    // part of the batch generated by a single thread
+    struct Block {
+        std::vector<int64_t> indptr;
+        std::vector<T> indices;
+        std::vector<T> values;
+    };
+    const size_t n_tables = tables.n_tables;
+    const T n_row = tables.n_row;
+    const T n_col = tables.n_col;
+    const size_t n_blocks = std::max<size_t>(std::min(n_threads, n_tables), 1);
+    std::vector<Block> blocks(n_blocks);
+    const uint64_t base_seed = resolve_seed(seed);
+
+    parallel_blocks(n_blocks, n_tables, [&](const size_t b, const size_t first, const size_t last) {
+        Block& block = blocks[b];
+        block.indptr.reserve((last - first) * static_cast<size_t>(n_row));
+
+        pcg64_dxsm rng;
+        ModeWalk cell;
+        std::unique_ptr<int64_t[]> jwork(new int64_t[n_col]);
+        CsrSink<T> sink{block.indptr, block.indices, block.values, static_cast<T>(n_col - 1)};
+        if (!reproducible) {
+            rng.seed(base_seed);
+            rng.set_stream(b + 1);
+        }
+        for (size_t i = first; i < last; i++) {
+            if (reproducible) {
+                seed_table_stream(rng, base_seed, i);
+            }
+            rcont2_sink<T, ModeWalk>(
+                n_row, n_col, static_cast<T>(n_total), n_row_sums, n_col_sums, sink, factorial_table, rng,
+                jwork.get(), cell
+            );
+        }
+    });
+
+    // concatenate the blocks
+    std::vector<size_t> nnz_offsets(n_blocks + 1, 0);
+    std::vector<size_t> row_offsets(n_blocks + 1, 0);
+    for (size_t b = 0; b < n_blocks; b++) {
+        nnz_offsets[b + 1] = nnz_offsets[b] + blocks[b].values.size();
+        row_offsets[b + 1] = row_offsets[b] + blocks[b].indptr.size();
+    }
+    tables.indptr.resize(row_offsets[n_blocks] + 1);
+    tables.indices.resize(nnz_offsets[n_blocks]);
+    tables.values.resize(nnz_offsets[n_blocks]);
+    tables.indptr[0] = 0;
+
+    parallel_tasks(n_threads, n_blocks, [&](const size_t b, const size_t) {
+        Block& block = blocks[b];
+        const int64_t shift = static_cast<int64_t>(nnz_offsets[b]);
+        for (size_t r = 0; r < block.indptr.size(); r++) {
+            tables.indptr[row_offsets[b] + r + 1] = block.indptr[r] + shift;
+        }
+        std::copy(block.indices.begin(), block.indices.end(), tables.indices.begin() + nnz_offsets[b]);
+        std::copy(block.values.begin(), block.values.end(), tables.values.begin() + nnz_offsets[b]);
+        // release the block as soon as it has been copied
+        std::vector<T>().swap(block.indices);
+        std::vector<T>().swap(block.values);
+    });
+}  // generate_sparse_tables_impl
+
+template<typename T, isInt<T> = true>
+inline SparseTables<T> generate_sparse_tables(
+    const size_t n_tables,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const bool reproducible = false
+) {
+    if (n_total == 0) {
+        n_total = check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums);
+    }
+    SparseTables<T> tables;
+    tables.n_tables = n_tables;
+    tables.n_row = n_row;
+    tables.n_col = n_col;
+
+    with_factorial_table(factorial_table, n_total, [&](const auto& table) {
+        generate_sparse_tables_impl<T>(tables, n_row_sums, n_col_sums, n_total, n_threads, seed, table, reproducible);
+    });
+    return tables;
+}  // generate_sparse_tables
+
+}  // namespace details
+
+/* Generate `n_tables` random two-way contingency tables in CSR format.
+ *
+ *  Only the non-zero cells are stored, see `SparseTables` for the format.
+ *
+ * Parameters
+ * ----------
+ * n_tables : number of tables to generate
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * n_total : optional, default = 0, the sum of the column or row sums
+ * n_threads : optional, default = 1, the number of threads used to generate
+ *             the tables
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ * reproducible : optional, default = false, draw table `i` from its own
+ *                random stream derived from `seed` and `i` such that the
+ *                tables are identical to those of `generate_contingency_tables`
+ *                and do not depend on `n_threads`.
+ *
+ *  Returns
+ *  -------
+ *  tables : the tables in compressed sparse row format
+ */
+SparseTables<int> generate_sparse_tables(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const bool reproducible = false
+);
+
+/* Generate `n_tables` random two-way contingency tables in CSR format.
+ *
+ *  Only the non-zero cells are stored, see `SparseTables` for the format.
+ *
+ * Parameters
+ * ----------
+ * n_tables : number of tables to generate
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * n_total : optional, default = 0, the sum of the column or row sums
+ * n_threads : optional, default = 1, the number of threads used to generate
+ *             the tables
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ * reproducible : optional, default = false, draw table `i` from its own
+ *                random stream derived from `seed` and `i` such that the
+ *                tables are identical to those of `generate_contingency_tables`
+ *                and do not depend on `n_threads`.
+ *
+ *  Returns
+ *  -------
+ *  tables : the tables in compressed sparse row format
+ */
+SparseTables<int64_t> generate_sparse_tables(
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const bool reproducible = false
+);
+
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_SPARSE_HPP_
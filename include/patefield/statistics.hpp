@@ -0,0 +1,410 @@
+/* statistics.hpp -- Test statistics of generated tables.
+ * Copyright 2022 R. Urlus
+ *
+ * Most tables are only generated to build the null distribution of a
+ * statistic. `generate_statistics` reduces every table to its statistic
+ * directly after it has been drawn, the table itself only lives in a
+ * per-thread scratch buffer that stays in cache.
+ */
+
+#ifndef INCLUDE_PATEFIELD_STATISTICS_HPP_
+#define INCLUDE_PATEFIELD_STATISTICS_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include <patefield/commons.hpp>
+#include <patefield/factorial.hpp>
+#include <patefield/parallel.hpp>
+#include <patefield/patefield.hpp>
+#include <patefield/rcont.hpp>
+#include <patefield/rcont_simd.hpp>
+
+namespace patefield {
+
+/* Statistic of a two-way contingency table with expected counts E = r_i * c_j / n.
+ *
+ * chi_square : Pearson's chi-square, sum (O - E)^2 / E
+ * g_test : log-likelihood ratio, 2 * sum O * ln(O / E)
+ * mutual_information : mutual information of rows and columns in nats, G / (2 * n)
+ * cramers_v : Cramér's V, sqrt(chi-square / (n * (min(n_row, n_col) - 1)))
+ */
+enum class Statistic : int { chi_square = 0, g_test = 1, mutual_information = 2, cramers_v = 3 };
+
+namespace details {
+
+/* Computes a `Statistic` for tables with fixed sums.
+ *
+ *  The terms that only depend on the marginals are computed once, tables
+ *  are expected in the layout written by `rcont2`, i.e. cell (i, j) at
+ *  `table[i + j * n_row]`.
+ */
+template<typename T, isInt<T> = true>
+class TableStatistic {
+    Statistic statistic_;
+    size_t block_size_;
+    double n_total_;
+    // n / (r_i * c_j) in the layout of the table
+    std::vector<double> inv_expected_;
+    // n ln n - sum r_i ln r_i - sum c_j ln c_j
+    double g_offset_;
+    double cramers_scale_;
+
+ public:
+    TableStatistic(
+        const Statistic statistic,
+        const T n_row,
+        const T n_col,
+        const T* n_row_sums,
+        const T* n_col_sums,
+        const int64_t n_total
+    ) :
+        statistic_{statistic},
+        block_size_{static_cast<size_t>(n_row) * static_cast<size_t>(n_col)},
+        n_total_{static_cast<double>(n_total)},
+        inv_expected_(block_size_) {
+        double g_offset = n_total_ * std::log(n_total_);
+        for (T i = 0; i < n_row; i++) {
+            const double r = static_cast<double>(n_row_sums[i]);
+            g_offset -= r * std::log(r);
+        }
+        for (T j = 0; j < n_col; j++) {
+            const double c = static_cast<double>(n_col_sums[j]);
+            g_offset -= c * std::log(c);
+            for (T i = 0; i < n_row; i++) {
+                inv_expected_[i + j * static_cast<size_t>(n_row)] = n_total_
+                    / (static_cast<double>(n_row_sums[i]) * c);
+            }
+        }
+        g_offset_ = g_offset;
+        cramers_scale_ = 1.0 / (n_total_ * static_cast<double>(std::min(n_row, n_col) - 1));
+    }
+
+    /* Pearson's chi-square as sum O^2 / E - n */
+    inline double chi_square(const T* table) const {
+        double acc = 0.0;
+        for (size_t k = 0; k < block_size_; k++) {
+            const double o = static_cast<double>(table[k]);
+            acc += o * o * inv_expected_[k];
+        }
+        return std::max(acc - n_total_, 0.0);
+    }
+
+    /* G-statistic as 2 * (sum O ln O + n ln n - sum r ln r - sum c ln c) */
+    inline double g_test(const T* table) const {
+        double acc = 0.0;
+        for (size_t k = 0; k < block_size_; k++) {
+            if (table[k] > 0) {
+                const double o = static_cast<double>(table[k]);
+                acc += o * std::log(o);
+            }
+        }
+        return std::max(2.0 * (acc + g_offset_), 0.0);
+    }
+
+    inline double operator()(const T* table) const {
+        switch (statistic_) {
+            case Statistic::g_test:
+                return g_test(table);
+            case Statistic::mutual_information:
+                return g_test(table) / (2.0 * n_total_);
+            case Statistic::cramers_v:
+                return std::sqrt(chi_square(table) * cramers_scale_);
+            default:
+                return chi_square(table);
+        }
+    }
+
+    Statistic statistic() const { return statistic_; }
+
+    /* n / (r_i * c_j) in the layout of the table. */
+    const double* inv_expected() const { return inv_expected_.data(); }
+
+    /* n ln n - sum r_i ln r_i - sum c_j ln c_j */
+    double g_offset() const { return g_offset_; }
+
+    /* 1 / (n * (min(n_row, n_col) - 1)) */
+    double cramers_scale() const { return cramers_scale_; }
+};  // TableStatistic
+
+/* Compute `statistic` of `n_tables` generated tables, see `generate_statistics`.
+ *
+ *  In reproducible mode the tables [first_table, first_table + n_tables) are
+ *  drawn such that consecutive calls continue the sequence.
+ */
+template<typename T, typename Table, isInt<T> = true>
+inline void generate_statistics_impl(
+    const size_t n_tables,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const int64_t n_total,
+    const TableStatistic<T>& statistic,
+    const size_t n_threads,
+    const uint64_t base_seed,
+    const Table& factorial_table,
+    double* result,
+    const bool reproducible,
+    const Kernel kernel,
+    const size_t first_table = 0
+) {
+    constexpr size_t W = simd_lanes;
+    const size_t block_size = static_cast<size_t>(n_row) * static_cast<size_t>(n_col);
+    // tables per step, the lanes of the simd kernel are drawn together
+    const size_t step = kernel == Kernel::simd ? W : 1;
+    const size_t n_steps = (n_tables + step - 1) / step;
+
+    parallel_blocks(n_threads, n_steps, [&](const size_t block, const size_t first_step, const size_t last_step) {
+        std::unique_ptr<T[]> scratch(new T[step * block_size]);
+        std::unique_ptr<int64_t[]> jwork(new int64_t[W * static_cast<size_t>(n_col)]);
+        pcg64_dxsm rng;
+        pcg64_dxsm* rngs[W];
+        T* results[W];
+        if (!reproducible) {
+            // the same streams as the non-reproducible `generate_contingency_tables`
+            rng.seed(base_seed);
+            rng.set_stream(block + 1);
+        }
+        for (size_t k = 0; k < W; k++) {
+            rngs[k] = &rng;
+            results[k] = scratch.get() + (std::min(k, step - 1) * block_size);
+        }
+
+        for (size_t s = first_step; s < last_step; s++) {
+            const size_t first = s * step;
+            const size_t n = std::min(step, n_tables - first);
+            if (reproducible) {
+                generate_table_range<T>(
+                    first_table + first, n, n_row, n_col, n_row_sums, n_col_sums, n_total, base_seed, factorial_table,
+                    scratch.get(), kernel, jwork.get()
+                );
+            } else if (kernel == Kernel::simd) {
+                rcont2_simd<T, W>(
+                    n, n_row, n_col, n_total, n_row_sums, n_col_sums, results, factorial_table, rngs, jwork.get()
+                );
+            } else {
+                rcont2<T>(
+                    n_row, n_col, n_total, n_row_sums, n_col_sums, scratch.get(), factorial_table, rng, jwork.get()
+                );
+            }
+            for (size_t k = 0; k < n; k++) {
+                result[first + k] = statistic(scratch.get() + (k * block_size));
+            }
+        }
+    });
+}  // generate_statistics_impl
+
+/* Compute `statistic` of `table` with the given sums. */
+template<typename T, isInt<T> = true>
+inline double compute_statistic(
+    const Statistic statistic,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const T* table
+) {
+    const int64_t n_total = check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums);
+    return TableStatistic<T>(statistic, n_row, n_col, n_row_sums, n_col_sums, n_total)(table);
+}  // compute_statistic
+
+/* Generate `n_tables` random tables and return their statistic.
+ *
+ *  Draws the same tables as `generate_contingency_tables` with the same
+ *  arguments but only stores a double per table.
+ */
+template<typename T, isInt<T> = true>
+inline double* generate_statistics(
+    const size_t n_tables,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    double* result = nullptr,
+    const bool reproducible = false,
+    const Kernel kernel = Kernel::scalar
+) {
+    if (n_total == 0) {
+        n_total = check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums);
+    }
+    if (!result) {
+        result = reinterpret_cast<double*>(std::malloc(n_tables * sizeof(double)));
+        if (!result) throw std::bad_alloc();
+    }
+    const TableStatistic<T> table_statistic(statistic, n_row, n_col, n_row_sums, n_col_sums, n_total);
+    const uint64_t base_seed = resolve_seed(seed);
+
+    with_factorial_table(factorial_table, n_total, [&](const auto& table) {
+        generate_statistics_impl<T>(
+            n_tables, n_row, n_col, n_row_sums, n_col_sums, n_total, table_statistic, n_threads, base_seed, table,
+            result, reproducible, kernel
+        );
+    });
+    return result;
+}  // generate_statistics
+
+}  // namespace details
+
+/* Compute a statistic of a two-way contingency table.
+ *
+ * Parameters
+ * ----------
+ * statistic : the statistic to compute
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums of the table, must be > 0;
+ * n_col_sums : the column sums of the table, must be > 0;
+ * table : the table of size [n_row * n_col] in the layout of the generators,
+ *         i.e. cell (i, j) at `table[i + j * n_row]`
+ *
+ *  Returns
+ *  -------
+ *  value : the statistic of the table
+ */
+double compute_statistic(
+    const Statistic statistic,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    const int* table
+);
+
+/* Compute a statistic of a two-way contingency table.
+ *
+ * Parameters
+ * ----------
+ * statistic : the statistic to compute
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums of the table, must be > 0;
+ * n_col_sums : the column sums of the table, must be > 0;
+ * table : the table of size [n_row * n_col] in the layout of the generators,
+ *         i.e. cell (i, j) at `table[i + j * n_row]`
+ *
+ *  Returns
+ *  -------
+ *  value : the statistic of the table
+ */
+double compute_statistic(
+    const Statistic statistic,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    const int64_t* table
+);
+
+/* Generate `n_tables` random two-way contingency tables and return their statistic.
+ *
+ *  The tables are reduced to the statistic as soon as they are drawn and are
+ *  never stored, the statistic of table `i` equals that of table `i` from
+ *  `generate_contingency_tables` called with the same arguments.
+ *
+ * Parameters
+ * ----------
+ * n_tables : number of tables to generate
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * statistic : the statistic to compute
+ * n_total : optional, default = 0, the sum of the column or row sums
+ * n_threads : optional, default = 1, the number of threads used to generate
+ *             the tables
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ * result : optional, pointer to the memory where the statistics will be stored,
+ *          must be of size [n_tables]
+ * reproducible : optional, default = false, draw table `i` from its own
+ *                random stream derived from `seed` and `i` such that the
+ *                result does not depend on `n_threads`.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables
+ *
+ *  Returns
+ *  -------
+ *  result : pointer to the memory where the statistics have been stored
+ */
+double* generate_statistics(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    double* result = nullptr,
+    const bool reproducible = false,
+    const Kernel kernel = Kernel::scalar
+);
+
+/* Generate `n_tables` random two-way contingency tables and return their statistic.
+ *
+ *  The tables are reduced to the statistic as soon as they are drawn and are
+ *  never stored, the statistic of table `i` equals that of table `i` from
+ *  `generate_contingency_tables` called with the same arguments.
+ *
+ * Parameters
+ * ----------
+ * n_tables : number of tables to generate
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * statistic : the statistic to compute
+ * n_total : optional, default = 0, the sum of the column or row sums
+ * n_threads : optional, default = 1, the number of threads used to generate
+ *             the tables
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ * result : optional, pointer to the memory where the statistics will be stored,
+ *          must be of size [n_tables]
+ * reproducible : optional, default = false, draw table `i` from its own
+ *                random stream derived from `seed` and `i` such that the
+ *                result does not depend on `n_threads`.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables
+ *
+ *  Returns
+ *  -------
+ *  result : pointer to the memory where the statistics have been stored
+ */
+double* generate_statistics(
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total = 0,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    double* result = nullptr,
+    const bool reproducible = false,
+    const Kernel kernel = Kernel::scalar
+);
+
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_STATISTICS_HPP_
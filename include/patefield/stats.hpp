@@ -0,0 +1,275 @@
+/* stats.hpp -- Counters of the work done inside the table kernels.
+ * Copyright 2022 R. Urlus
+ *
+ * The counters are only collected when the library is built with
+ * `PATEFIELD_ENABLE_STATS`, otherwise the hooks in the kernels are empty
+ * inline functions and `kernel_stats` returns zeros. Every thread counts in
+ * its own slot, the slots are summed when the statistics are read.
+ */
+
+#ifndef INCLUDE_PATEFIELD_STATS_HPP_
+#define INCLUDE_PATEFIELD_STATS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace patefield {
+
+/* Counters of the table kernels.
+ *
+ * tables : number of generated tables
+ * cells : number of cells drawn from their conditional distribution
+ * mode_accepts : cells accepted at the mode, `r <= x`
+ * walk_accepts : cells found while walking up or down from the mode
+ * walk_steps : number of steps taken by the walks, up and down
+ * restarts : walks exhausted without acceptance, restarted with a new uniform
+ * early_exits : rows finished early because the remaining total is zero
+ * rng_draws : number of uniforms drawn by the kernels
+ * mode_ns : nanoseconds spent computing the mode and its probability
+ * walk_ns : nanoseconds spent walking from the mode
+ */
+struct KernelStats {
+    uint64_t tables = 0;
+    uint64_t cells = 0;
+    uint64_t mode_accepts = 0;
+    uint64_t walk_accepts = 0;
+    uint64_t walk_steps = 0;
+    uint64_t restarts = 0;
+    uint64_t early_exits = 0;
+    uint64_t rng_draws = 0;
+    uint64_t mode_ns = 0;
+    uint64_t walk_ns = 0;
+
+    KernelStats& operator+=(const KernelStats& other) {
+        tables += other.tables;
+        cells += other.cells;
+        mode_accepts += other.mode_accepts;
+        walk_accepts += other.walk_accepts;
+        walk_steps += other.walk_steps;
+        restarts += other.restarts;
+        early_exits += other.early_exits;
+        rng_draws += other.rng_draws;
+        mode_ns += other.mode_ns;
+        walk_ns += other.walk_ns;
+        return *this;
+    }
+};  // KernelStats
+
+/* True when the library collects `KernelStats`. */
+constexpr bool kernel_stats_enabled() {
+#if defined(PATEFIELD_HAS_STATS_SUPPORT)
+    return true;
+#else
+    return false;
+#endif
+}
+
+namespace details {
+
+enum class Stat : size_t {
+    tables = 0,
+    cells,
+    mode_accepts,
+    walk_accepts,
+    walk_steps,
+    restarts,
+    early_exits,
+    rng_draws,
+    mode_ns,
+    walk_ns,
+    count
+};
+
+constexpr size_t n_stats = static_cast<size_t>(Stat::count);
+
+/* Counters of one thread, only written by its owner. */
+struct StatSlot {
+    std::atomic<uint64_t> values[n_stats];
+
+    StatSlot() {
+        for (auto& value : values) {
+            value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    inline void add(const Stat stat, const uint64_t n) {
+        std::atomic<uint64_t>& value = values[static_cast<size_t>(stat)];
+        // single writer, a load and store avoids the locked read-modify-write
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    KernelStats snapshot() const {
+        auto get = [this](const Stat stat) {
+            return values[static_cast<size_t>(stat)].load(std::memory_order_relaxed);
+        };
+        KernelStats stats;
+        stats.tables = get(Stat::tables);
+        stats.cells = get(Stat::cells);
+        stats.mode_accepts = get(Stat::mode_accepts);
+        stats.walk_accepts = get(Stat::walk_accepts);
+        stats.walk_steps = get(Stat::walk_steps);
+        stats.restarts = get(Stat::restarts);
+        stats.early_exits = get(Stat::early_exits);
+        stats.rng_draws = get(Stat::rng_draws);
+        stats.mode_ns = get(Stat::mode_ns);
+        stats.walk_ns = get(Stat::walk_ns);
+        return stats;
+    }
+
+    void reset() {
+        for (auto& value : values) {
+            value.store(0, std::memory_order_relaxed);
+        }
+    }
+};  // StatSlot
+
+/* The slots of the running threads and the totals of the finished ones. */
+struct StatRegistry {
+    std::mutex mutex;
+    std::vector<StatSlot*> slots;
+    KernelStats retired;
+};
+
+inline StatRegistry& stat_registry() {
+    // never destroyed, threads of static pools unregister during exit
+    static StatRegistry* registry = new StatRegistry();
+    return *registry;
+}
+
+/* Slot of the calling thread, registered on first use. */
+class ThreadStatSlot {
+    StatSlot slot_;
+
+ public:
+    ThreadStatSlot() {
+        StatRegistry& registry = stat_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.slots.push_back(&slot_);
+    }
+
+    ~ThreadStatSlot() {
+        StatRegistry& registry = stat_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.retired += slot_.snapshot();
+        for (size_t i = 0; i < registry.slots.size(); i++) {
+            if (registry.slots[i] == &slot_) {
+                registry.slots.erase(registry.slots.begin() + static_cast<std::ptrdiff_t>(i));
+                break;
+            }
+        }
+    }
+
+    ThreadStatSlot(const ThreadStatSlot&) = delete;
+    ThreadStatSlot& operator=(const ThreadStatSlot&) = delete;
+
+    StatSlot& get() { return slot_; }
+};  // ThreadStatSlot
+
+inline StatSlot& thread_stat_slot() {
+    thread_local ThreadStatSlot slot;
+    return slot.get();
+}
+
+/* Add `n` to `stat` of the calling thread, a no-op without `PATEFIELD_HAS_STATS_SUPPORT`. */
+inline void count_stat(const Stat stat, const uint64_t n = 1) {
+#if defined(PATEFIELD_HAS_STATS_SUPPORT)
+    thread_stat_slot().add(stat, n);
+#else
+    (void)stat;
+    (void)n;
+#endif
+}
+
+/* Adds the lifetime of the timer to `stat`, empty without `PATEFIELD_HAS_STATS_SUPPORT`. */
+class PhaseTimer {
+#if defined(PATEFIELD_HAS_STATS_SUPPORT)
+    Stat stat_;
+    std::chrono::steady_clock::time_point start_;
+    bool running_ = true;
+
+ public:
+    explicit PhaseTimer(const Stat stat) : stat_{stat}, start_{std::chrono::steady_clock::now()} {}
+
+    ~PhaseTimer() { stop(); }
+
+    /* End the phase before the end of the scope. */
+    void stop() {
+        if (running_) {
+            const auto elapsed = std::chrono::steady_clock::now() - start_;
+            count_stat(
+                stat_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count())
+            );
+            running_ = false;
+        }
+    }
+#else
+
+ public:
+    explicit PhaseTimer(const Stat) {}
+    void stop() {}
+#endif
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+};  // PhaseTimer
+
+/* Sum of the counters of all threads, including the finished ones. */
+inline KernelStats collect_kernel_stats() {
+    StatRegistry& registry = stat_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    KernelStats total = registry.retired;
+    for (const StatSlot* slot : registry.slots) {
+        total += slot->snapshot();
+    }
+    return total;
+}
+
+/* Counters of every running thread that has generated tables. */
+inline std::vector<KernelStats> collect_thread_kernel_stats() {
+    StatRegistry& registry = stat_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::vector<KernelStats> stats;
+    stats.reserve(registry.slots.size());
+    for (const StatSlot* slot : registry.slots) {
+        stats.push_back(slot->snapshot());
+    }
+    return stats;
+}
+
+inline void reset_kernel_stats() {
+    StatRegistry& registry = stat_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.retired = KernelStats();
+    for (StatSlot* slot : registry.slots) {
+        slot->reset();
+    }
+}
+
+}  // namespace details
+
+/* Counters of the table kernels summed over all threads.
+ *
+ *  Zero unless the library was built with `PATEFIELD_ENABLE_STATS`, see
+ *  `kernel_stats_enabled()`. The timings add up the time of every thread.
+ */
+KernelStats kernel_stats();
+
+/* Counters of the table kernels per running thread.
+ *
+ *  One entry per thread that has generated tables and is still alive, e.g.
+ *  the workers of the thread pool, in the order in which they started.
+ */
+std::vector<KernelStats> thread_kernel_stats();
+
+/* Set the counters of the table kernels to zero.
+ *
+ *  Should not be called while tables are generated, the counts of a
+ *  running kernel may survive the reset.
+ */
+void reset_kernel_stats();
+
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_STATS_HPP_
@@ -0,0 +1,131 @@
+/* stream.hpp -- Generate tables in bounded chunks.
+ * Copyright 2022 R. Urlus
+ */
+
+#ifndef INCLUDE_PATEFIELD_STREAM_HPP_
+#define INCLUDE_PATEFIELD_STREAM_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <patefield/commons.hpp>
+#include <patefield/factorial.hpp>
+#include <patefield/parallel.hpp>
+#include <patefield/patefield.hpp>
+
+namespace patefield {
+
+/* Generate `n_tables` random two-way contingency tables and pass them to `consumer`.
+ *
+ *  Every thread generates the tables in chunks of at most `chunk_size` into
+ *  its own buffer, the memory used is [n_threads * chunk_size * n_row * n_col]
+ *  rather than [n_tables * n_row * n_col]. After each chunk the consumer is
+ *  called as
+ *
+ *      consumer(first, n, tables)
+ *
+ *  where `tables` points to the `n` tables [first, first + n), table `first + k`
+ *  starts at `tables + k * n_row * n_col`. The buffer is only valid for the
+ *  duration of the call. The consumer is called concurrently from all threads
+ *  and chunks are handed out in no particular order.
+ *  When the consumer throws the remaining chunks are skipped and the first
+ *  exception is rethrown.
+ *
+ *  Table `i` is drawn from its own stream derived from `seed` and `i`, the
+ *  tables are identical to those of `generate_contingency_tables` with
+ *  `reproducible = true` for any `chunk_size` and `n_threads`.
+ *
+ * Parameters
+ * ----------
+ * n_tables : number of tables to generate
+ * n_row : number of rows in the table, must be >= 2;
+ * n_col : number of columns in the table, must be >= 2;
+ * n_row_sums : the row sums, must be > 0;
+ * n_col_sums : the column sums, must be > 0;
+ * consumer : callable with signature `void(size_t, size_t, const T*)`
+ * n_total : optional, default = 0, the sum of the column or row sums
+ * chunk_size : optional, default = 1024, the maximum number of tables per call
+ * n_threads : optional, default = 1, the number of threads used to generate
+ *             the tables
+ * seed : optional, a seed for the random number generator,
+ *        default = 0, i.e. drawn as described by `generate_contingency_tables`.
+ * factorial_table : optional, pointer to table containing the log factorials,
+ *                   can be created using `patefield::create_factorial_table`
+ *                   Otherwise the process-wide factorial table is used.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables
+ */
+template<typename T, typename Consumer, isInt<T> = true>
+inline void stream_contingency_tables(
+    const size_t n_tables,
+    const T n_row,
+    const T n_col,
+    const T* n_row_sums,
+    const T* n_col_sums,
+    Consumer&& consumer,
+    int64_t n_total = 0,
+    const size_t chunk_size = 1024,
+    const size_t n_threads = 1,
+    const uint64_t seed = 0,
+    double* factorial_table = nullptr,
+    const Kernel kernel = Kernel::scalar
+) {
+    if (chunk_size == 0) {
+        throw InputError("patefield: chunk_size must be positive.\n");
+    }
+    if (n_total == 0) {
+        n_total = details::check_inputs<T>(n_row, n_col, n_row_sums, n_col_sums);
+    }
+    const size_t block_size = static_cast<size_t>(n_row) * static_cast<size_t>(n_col);
+    const size_t n_chunks = (n_tables + chunk_size - 1) / chunk_size;
+    const uint64_t base_seed = details::resolve_seed(seed);
+
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    std::atomic<bool> failed{false};
+
+    details::with_factorial_table(factorial_table, n_total, [&](const auto& table) {
+        // buffers of the workers, allocated by the first chunk a worker runs
+        const size_t n_workers = details::parallel_workers(n_threads);
+        std::vector<std::unique_ptr<T[]>> buffers(n_workers);
+        std::vector<std::unique_ptr<int64_t[]>> jworks(n_workers);
+
+        details::parallel_tasks(n_threads, n_chunks, [&](const size_t c, const size_t worker) {
+            if (failed.load(std::memory_order_relaxed)) {
+                return;
+            }
+            if (!buffers[worker]) {
+                buffers[worker].reset(new T[std::min(chunk_size, n_tables) * block_size]);
+                jworks[worker].reset(new int64_t[details::simd_lanes * static_cast<size_t>(n_col)]);
+            }
+            const size_t first = c * chunk_size;
+            const size_t n = std::min(chunk_size, n_tables - first);
+            details::generate_table_range<T>(
+                first, n, n_row, n_col, n_row_sums, n_col_sums, n_total, base_seed, table, buffers[worker].get(),
+                kernel, jworks[worker].get()
+            );
+            try {
+                consumer(first, n, static_cast<const T*>(buffers[worker].get()));
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                failed.store(true, std::memory_order_relaxed);
+            }
+        });
+    });
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}  // stream_contingency_tables
+
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_STREAM_HPP_
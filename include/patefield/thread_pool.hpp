@@ -0,0 +1,217 @@
+/* thread_pool.hpp -- Persistent work-stealing thread pool.
+ * Copyright 2022 R. Urlus
+ */
+
+#ifndef INCLUDE_PATEFIELD_THREAD_POOL_HPP_
+#define INCLUDE_PATEFIELD_THREAD_POOL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <patefield/executor.hpp>
+
+namespace patefield {
+
+/* Pool of worker threads that run bulk tasks with work stealing.
+ *
+ *  The threads are started once and kept alive between calls of `run`.
+ *  The tasks of a call are divided evenly over the workers, a worker that
+ *  has run out of tasks steals from the back of the queue of another worker
+ *  such that tasks of uneven cost are balanced over the threads. Derived
+ *  pools can restrict which queues are stolen from with `can_steal`.
+ *
+ * Parameters
+ * ----------
+ * n_threads : optional, default = 0, the number of workers, 0 uses the
+ *             number of hardware threads
+ */
+class ThreadPool : public Executor {
+    // range of task indices owned by a worker, taken from the front and stolen from the back
+    struct Queue {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    size_t n_workers_;
+    std::unique_ptr<Queue[]> queues_;
+    std::vector<std::thread> workers_;
+
+    // one call of `run` at a time
+    std::mutex run_mutex_;
+    // guards generation_, busy_ and stop_
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(size_t, size_t)>* task_ = nullptr;
+    uint64_t generation_ = 0;
+    size_t busy_ = 0;
+    bool stop_ = false;
+    std::atomic<size_t> remaining_{0};
+
+    std::mutex error_mutex_;
+    std::atomic<bool> failed_{false};
+    std::exception_ptr error_;
+
+    bool pop(const size_t worker, size_t& task) {
+        Queue& queue = queues_[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.begin == queue.end) {
+            return false;
+        }
+        task = queue.begin++;
+        return true;
+    }
+
+    bool steal(const size_t worker, size_t& task) {
+        for (size_t k = 1; k < n_workers_; k++) {
+            const size_t victim = (worker + k) % n_workers_;
+            if (!can_steal(worker, victim)) {
+                continue;
+            }
+            Queue& queue = queues_[victim];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.begin != queue.end) {
+                task = --queue.end;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(const size_t worker, const std::function<void(size_t)>& init) {
+        if (init) {
+            init(worker);
+        }
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                if (stop_) {
+                    return;
+                }
+                seen = generation_;
+                busy_++;
+            }
+            size_t task;
+            while (pop(worker, task) || steal(worker, task)) {
+                if (!failed_.load(std::memory_order_relaxed)) {
+                    try {
+                        (*task_)(task, worker);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(error_mutex_);
+                        if (!error_) {
+                            error_ = std::current_exception();
+                        }
+                        failed_.store(true, std::memory_order_relaxed);
+                    }
+                }
+                remaining_.fetch_sub(1, std::memory_order_acq_rel);
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                busy_--;
+            }
+            done_.notify_all();
+        }
+    }
+
+ protected:
+    /* True when `worker` may steal the tasks of `victim`, by default any worker may.
+     *
+     *  Only called from within `run`, after the pool has been constructed.
+     */
+    virtual bool can_steal(const size_t worker, const size_t victim) const {
+        (void)worker;
+        (void)victim;
+        return true;
+    }
+
+ public:
+    /* Start the workers, `init(worker)` is called on every worker thread before its first task. */
+    explicit ThreadPool(const size_t n_threads = 0, std::function<void(size_t)> init = nullptr) :
+        n_workers_{n_threads > 0 ? n_threads : std::max<size_t>(std::thread::hardware_concurrency(), 1)},
+        queues_{new Queue[n_workers_]} {
+        workers_.reserve(n_workers_);
+        for (size_t w = 0; w < n_workers_; w++) {
+            workers_.emplace_back([this, w, init] { work(w, init); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    /* Number of worker threads. */
+    size_t size() const override { return n_workers_; }
+
+    /* Call `task(i, worker)` for every i in [0, n_tasks) and wait for completion.
+     *
+     *  `worker` is the index of the thread in [0, size()) running the task
+     *  which can be used to index per-thread scratch space. When a task
+     *  throws the remaining tasks are skipped and the first exception is
+     *  rethrown. Must not be called from within a task.
+     */
+    void run(const size_t n_tasks, const std::function<void(size_t, size_t)>& task) override {
+        if (n_tasks == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> run_lock(run_mutex_);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // workers that woke late for the previous call must have left it
+            done_.wait(lock, [&] { return busy_ == 0; });
+            for (size_t w = 0; w < n_workers_; w++) {
+                std::lock_guard<std::mutex> queue_lock(queues_[w].mutex);
+                queues_[w].begin = (w * n_tasks) / n_workers_;
+                queues_[w].end = ((w + 1) * n_tasks) / n_workers_;
+            }
+            task_ = &task;
+            error_ = nullptr;
+            failed_.store(false, std::memory_order_relaxed);
+            remaining_.store(n_tasks, std::memory_order_release);
+            generation_++;
+        }
+        wake_.notify_all();
+
+        std::exception_ptr error;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [&] { return remaining_.load(std::memory_order_acquire) == 0 && busy_ == 0; });
+            task_ = nullptr;
+            error = error_;
+            error_ = nullptr;
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};  // ThreadPool
+
+/* Process-wide pool with a worker per hardware thread, created on first use. */
+inline ThreadPool& default_thread_pool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_THREAD_POOL_HPP_
@@ -0,0 +1,73 @@
+/* uniform.hpp -- Uniforms over the open interval (0, 1) from PCG output.
+ * Copyright 2022 R. Urlus
+ *
+ * A uniform is the top 53 bits of a single 64-bit output of the engine,
+ * offset by half a unit in the last place such that neither 0 nor 1 can
+ * be drawn. Unlike `std::uniform_real_distribution` this consumes exactly
+ * one output per uniform and gives the same values on every standard
+ * library.
+ */
+
+#ifndef INCLUDE_PATEFIELD_UNIFORM_HPP_
+#define INCLUDE_PATEFIELD_UNIFORM_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <patefield/commons.hpp>
+
+namespace patefield {
+namespace details {
+
+/* Map 64 random bits to a double in (0, 1), the values are (k + 0.5) / 2^53. */
+inline double bits_to_open_uniform(const uint64_t bits) {
+    constexpr double scale = 1.0 / 9007199254740992.0;  // 2^-53
+    return (static_cast<double>(bits >> 11) + 0.5) * scale;
+}
+
+/* Uniform over the open set (0, 1) drawing one output of `rng` per value. */
+struct OpenUniform {
+    inline double operator()(pcg64_dxsm& rng) const {
+        return bits_to_open_uniform(rng());
+    }
+};  // OpenUniform
+
+/* Uniform over the open set (0, 1) that draws `N` values of `rng` at a time.
+ *
+ *  The values are those of `OpenUniform` in the same order, as long as
+ *  every call passes the same engine and the engine is not used or
+ *  reseeded elsewhere in between. Call `reset` when it is, the values
+ *  that remain in the buffer are discarded.
+ */
+template<size_t N = 64>
+class UniformBuffer {
+    double values_[N];
+    size_t next_ = N;
+
+    void fill(pcg64_dxsm& rng) {
+        uint64_t bits[N];
+        for (size_t k = 0; k < N; k++) {
+            bits[k] = rng();
+        }
+        // separate loop such that the conversion is vectorized
+        for (size_t k = 0; k < N; k++) {
+            values_[k] = bits_to_open_uniform(bits[k]);
+        }
+        next_ = 0;
+    }
+
+ public:
+    inline double operator()(pcg64_dxsm& rng) {
+        if (next_ == N) {
+            fill(rng);
+        }
+        return values_[next_++];
+    }
+
+    /* Discard the buffered values. */
+    void reset() { next_ = N; }
+};  // UniformBuffer
+
+}  // namespace details
+}  // namespace patefield
+#endif  // INCLUDE_PATEFIELD_UNIFORM_HPP_
@@ -0,0 +1,361 @@
+/* patefield_python.cpp -- Python bindings of the Patefield generators.
+ * Copyright 2022 R. Urlus
+ *
+ * The tables are written directly into NumPy arrays, either passed by the
+ * caller or allocated by the module, and returned with the strides of the
+ * layout the generator wrote, no copy is made. The memory is owned by the
+ * arrays and the factorial tables by their Python objects such that
+ * nothing leaks. The GIL is released while the tables are generated.
+ */
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <patefield/commons.hpp>
+#include <patefield/patefield.hpp>
+#include <patefield/sampler.hpp>
+#include <patefield/statistics.hpp>
+
+namespace py = pybind11;
+
+namespace {
+
+template<typename T>
+using Marginals = py::array_t<T, py::array::c_style | py::array::forcecast>;
+
+/* Log-factorials of [0, n_total] owned by a Python object. */
+class FactorialTable {
+    std::unique_ptr<double, decltype(&std::free)> table_;
+    int64_t n_total_;
+
+ public:
+    explicit FactorialTable(const int64_t n_total) :
+        table_{patefield::create_factorial_table(n_total), &std::free}, n_total_{n_total} {}
+
+    double* data() const { return table_.get(); }
+    int64_t n_total() const { return n_total_; }
+};  // FactorialTable
+
+/* The table pointer of `factorial_table`, which must hold the log-factorials up to `n_total`. */
+double* factorial_data(const FactorialTable* factorial_table, const int64_t n_total) {
+    if (!factorial_table) {
+        return nullptr;
+    }
+    if (factorial_table->n_total() < n_total) {
+        throw py::value_error("factorial_table is smaller than the sum of the marginals");
+    }
+    return factorial_table->data();
+}
+
+/* The sum of the marginals, an `InputError` when they are invalid. */
+template<typename T>
+int64_t marginal_total(const Marginals<T>& row_sums, const Marginals<T>& col_sums) {
+    return patefield::details::check_inputs<T>(
+        static_cast<T>(row_sums.size()), static_cast<T>(col_sums.size()), row_sums.data(), col_sums.data()
+    );
+}
+
+/* True when the strides of `array` in bytes are `expected` times the item size, ignoring dimensions of size 1. */
+bool has_strides(const py::array& array, const std::vector<py::ssize_t>& expected) {
+    for (size_t d = 0; d < expected.size(); d++) {
+        const py::ssize_t dim = static_cast<py::ssize_t>(d);
+        if (array.shape(dim) > 1 && array.strides(dim) != expected[d] * array.itemsize()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Check the shape of a caller-owned `result` and return the layout matching its strides. */
+patefield::Layout result_layout(
+    const py::array& result,
+    const py::ssize_t n_tables,
+    const py::ssize_t n_row,
+    const py::ssize_t n_col
+) {
+    if (result.ndim() != 3 || result.shape(0) != n_tables || result.shape(1) != n_row || result.shape(2) != n_col) {
+        throw py::value_error("result must have shape (n_tables, n_row, n_col)");
+    }
+    if (!result.writeable()) {
+        throw py::value_error("result must be writeable");
+    }
+    const py::ssize_t block_size = n_row * n_col;
+    if (has_strides(result, {block_size, 1, n_row})) {
+        return patefield::Layout::column_major;
+    }
+    if (has_strides(result, {block_size, n_col, 1})) {
+        return patefield::Layout::row_major;
+    }
+    if (has_strides(result, {1, n_col * n_tables, n_tables})) {
+        return patefield::Layout::cell_major;
+    }
+    throw py::value_error("result must be contiguous per table in column or row major order, or cell major");
+}
+
+/* A new array of `n_tables` tables, column major per table as written by `rcont2`. */
+template<typename T>
+py::array_t<T> new_tables(const py::ssize_t n_tables, const py::ssize_t n_row, const py::ssize_t n_col) {
+    const py::ssize_t size = static_cast<py::ssize_t>(sizeof(T));
+    return py::array_t<T>(
+        std::vector<py::ssize_t>{n_tables, n_row, n_col},
+        std::vector<py::ssize_t>{n_row * n_col * size, size, n_row * size}
+    );
+}
+
+template<typename T>
+py::array generate_tables(
+    const size_t n_tables,
+    const py::handle row_sums_arg,
+    const py::handle col_sums_arg,
+    const py::object& result_arg,
+    const size_t n_threads,
+    const uint64_t seed,
+    const bool reproducible,
+    const patefield::Kernel kernel,
+    const FactorialTable* factorial_table
+) {
+    const Marginals<T> row_sums = Marginals<T>::ensure(row_sums_arg);
+    const Marginals<T> col_sums = Marginals<T>::ensure(col_sums_arg);
+    if (!row_sums || !col_sums) {
+        throw py::type_error("row_sums and col_sums must be convertible to integer arrays");
+    }
+    const int64_t n_total = marginal_total<T>(row_sums, col_sums);
+    const py::ssize_t n_row = row_sums.size();
+    const py::ssize_t n_col = col_sums.size();
+    double* table = factorial_data(factorial_table, n_total);
+
+    py::array result;
+    patefield::Layout layout = patefield::Layout::column_major;
+    if (result_arg.is_none()) {
+        result = new_tables<T>(static_cast<py::ssize_t>(n_tables), n_row, n_col);
+    } else {
+        if (!py::isinstance<py::array_t<T>>(result_arg)) {
+            throw py::type_error("result must be an array with the dtype of the tables");
+        }
+        result = py::reinterpret_borrow<py::array>(result_arg);
+        layout = result_layout(result, static_cast<py::ssize_t>(n_tables), n_row, n_col);
+    }
+    T* data = static_cast<T*>(result.mutable_data());
+    {
+        py::gil_scoped_release release;
+        patefield::generate_contingency_tables(
+            n_tables, static_cast<T>(n_row), static_cast<T>(n_col), row_sums.data(), col_sums.data(), n_total,
+            n_threads, seed, table, data, reproducible, kernel, layout
+        );
+    }
+    return result;
+}  // generate_tables
+
+/* The dtype of the tables, that of `result` when it is given. */
+py::dtype table_dtype(const py::object& result, const py::object& dtype) {
+    if (!result.is_none()) {
+        return py::reinterpret_borrow<py::array>(result).dtype();
+    }
+    return dtype.is_none() ? py::dtype::of<int64_t>() : py::dtype::from_args(dtype);
+}
+
+py::array generate_contingency_tables(
+    const size_t n_tables,
+    const py::object& row_sums,
+    const py::object& col_sums,
+    const py::object& result,
+    const size_t n_threads,
+    const uint64_t seed,
+    const bool reproducible,
+    const patefield::Kernel kernel,
+    const FactorialTable* factorial_table,
+    const py::object& dtype
+) {
+    if (!result.is_none() && !py::isinstance<py::array>(result)) {
+        throw py::type_error("result must be a NumPy array");
+    }
+    const py::dtype table_type = table_dtype(result, dtype);
+    if (table_type.kind() == 'i' && table_type.itemsize() == 4) {
+        return generate_tables<int>(
+            n_tables, row_sums, col_sums, result, n_threads, seed, reproducible, kernel, factorial_table
+        );
+    }
+    if (table_type.kind() == 'i' && table_type.itemsize() == 8) {
+        return generate_tables<int64_t>(
+            n_tables, row_sums, col_sums, result, n_threads, seed, reproducible, kernel, factorial_table
+        );
+    }
+    throw py::type_error("the tables must be of dtype int32 or int64");
+}  // generate_contingency_tables
+
+py::array_t<double> generate_statistics(
+    const size_t n_tables,
+    const Marginals<int64_t>& row_sums,
+    const Marginals<int64_t>& col_sums,
+    const patefield::Statistic statistic,
+    const py::object& result_arg,
+    const size_t n_threads,
+    const uint64_t seed,
+    const bool reproducible,
+    const patefield::Kernel kernel,
+    const FactorialTable* factorial_table
+) {
+    const int64_t n_total = marginal_total<int64_t>(row_sums, col_sums);
+    double* table = factorial_data(factorial_table, n_total);
+    py::array_t<double> result;
+    if (result_arg.is_none()) {
+        result = py::array_t<double>(static_cast<py::ssize_t>(n_tables));
+    } else {
+        if (!py::isinstance<py::array_t<double>>(result_arg)) {
+            throw py::type_error("result must be an array of dtype float64");
+        }
+        result = py::reinterpret_borrow<py::array_t<double>>(result_arg);
+        if (result.ndim() != 1 || result.shape(0) != static_cast<py::ssize_t>(n_tables)
+            || !has_strides(result, {1})) {
+            throw py::value_error("result must be a contiguous array of shape (n_tables,)");
+        }
+    }
+    double* data = result.mutable_data();
+    {
+        py::gil_scoped_release release;
+        patefield::generate_statistics(
+            n_tables, static_cast<int64_t>(row_sums.size()), static_cast<int64_t>(col_sums.size()), row_sums.data(),
+            col_sums.data(), statistic, n_total, n_threads, seed, table, data, reproducible, kernel
+        );
+    }
+    return result;
+}  // generate_statistics
+
+typedef patefield::Sampler<int64_t> Sampler;
+
+/* `out` or a new array for `n_tables` tables of `sampler`, column major per table. */
+py::array_t<int64_t> sampler_output(const Sampler& sampler, const py::ssize_t n_tables, const py::object& out) {
+    const py::ssize_t n_row = static_cast<py::ssize_t>(sampler.n_row());
+    const py::ssize_t n_col = static_cast<py::ssize_t>(sampler.n_col());
+    if (out.is_none()) {
+        return new_tables<int64_t>(n_tables, n_row, n_col);
+    }
+    if (!py::isinstance<py::array_t<int64_t>>(out)) {
+        throw py::type_error("out must be an array of dtype int64");
+    }
+    py::array_t<int64_t> result = py::reinterpret_borrow<py::array_t<int64_t>>(out);
+    if (result_layout(result, n_tables, n_row, n_col) != patefield::Layout::column_major) {
+        throw py::value_error("out must be column major per table, e.g. the tables returned by the sampler");
+    }
+    return result;
+}
+
+}  // namespace
+
+PYBIND11_MODULE(patefield, m) {
+    m.doc() = "Random two-way contingency tables with given marginals using Patefield's algorithm.";
+
+    py::register_exception<patefield::InputError>(m, "InputError", PyExc_ValueError);
+
+    py::enum_<patefield::Kernel>(m, "Kernel")
+        .value("scalar", patefield::Kernel::scalar)
+        .value("simd", patefield::Kernel::simd);
+
+    py::enum_<patefield::Statistic>(m, "Statistic")
+        .value("chi_square", patefield::Statistic::chi_square)
+        .value("g_test", patefield::Statistic::g_test)
+        .value("mutual_information", patefield::Statistic::mutual_information)
+        .value("cramers_v", patefield::Statistic::cramers_v);
+
+    py::class_<FactorialTable>(
+        m, "FactorialTable", "Log-factorials of [0, n_total] that can be shared between calls and samplers."
+    )
+        .def(py::init<int64_t>(), py::arg("n_total"))
+        .def_property_readonly("n_total", &FactorialTable::n_total);
+
+    m.def(
+        "generate_contingency_tables",
+        &generate_contingency_tables,
+        "Generate `n_tables` tables with the given marginals.\n\n"
+        "The tables are returned with shape (n_tables, n_row, n_col). `result` can be a writeable\n"
+        "array of that shape that is filled in place, it is written in the layout given by its\n"
+        "strides: column major per table (the layout of rcont2), row major per table or cell major.\n"
+        "A new array is column major per table. The GIL is released while the tables are generated.",
+        py::arg("n_tables"),
+        py::arg("row_sums"),
+        py::arg("col_sums"),
+        py::arg("result") = py::none(),
+        py::arg("n_threads") = 1,
+        py::arg("seed") = 0,
+        py::arg("reproducible") = false,
+        py::arg("kernel") = patefield::Kernel::scalar,
+        py::arg("factorial_table") = py::none(),
+        py::arg("dtype") = py::none()
+    );
+
+    m.def(
+        "generate_statistics",
+        &generate_statistics,
+        "Generate `n_tables` tables with the given marginals and return their statistic.\n\n"
+        "`result` can be a writeable contiguous float64 array of shape (n_tables,) that is filled in place.",
+        py::arg("n_tables"),
+        py::arg("row_sums"),
+        py::arg("col_sums"),
+        py::arg("statistic") = patefield::Statistic::chi_square,
+        py::arg("result") = py::none(),
+        py::arg("n_threads") = 1,
+        py::arg("seed") = 0,
+        py::arg("reproducible") = false,
+        py::arg("kernel") = patefield::Kernel::scalar,
+        py::arg("factorial_table") = py::none()
+    );
+
+    py::class_<Sampler>(
+        m, "Sampler", "Sampler of tables with fixed marginals that keeps its factorial table between calls."
+    )
+        .def(
+            py::init([](const Marginals<int64_t>& row_sums, const Marginals<int64_t>& col_sums, const uint64_t seed,
+                        const FactorialTable* factorial_table) {
+                const int64_t n_total = marginal_total<int64_t>(row_sums, col_sums);
+                return new Sampler(
+                    static_cast<int64_t>(row_sums.size()), static_cast<int64_t>(col_sums.size()), row_sums.data(),
+                    col_sums.data(), seed, factorial_data(factorial_table, n_total)
+                );
+            }),
+            py::arg("row_sums"),
+            py::arg("col_sums"),
+            py::arg("seed") = 0,
+            py::arg("factorial_table") = py::none(),
+            // the sampler reads the factorial table, keep it alive
+            py::keep_alive<1, 5>()
+        )
+        .def(
+            "sample",
+            [](Sampler& sampler, const py::object& out) {
+                py::array_t<int64_t> result = sampler_output(sampler, 1, out);
+                int64_t* data = result.mutable_data();
+                {
+                    py::gil_scoped_release release;
+                    sampler.sample(data);
+                }
+                return result;
+            },
+            "Draw a table, returned with shape (1, n_row, n_col).",
+            py::arg("out") = py::none()
+        )
+        .def(
+            "sample_n",
+            [](Sampler& sampler, const size_t n_tables, const py::object& out) {
+                py::array_t<int64_t> result = sampler_output(sampler, static_cast<py::ssize_t>(n_tables), out);
+                int64_t* data = result.mutable_data();
+                {
+                    py::gil_scoped_release release;
+                    sampler.sample_n(n_tables, data);
+                }
+                return result;
+            },
+            "Draw `n_tables` tables, returned with shape (n_tables, n_row, n_col).",
+            py::arg("n_tables"),
+            py::arg("out") = py::none()
+        )
+        .def("set_seed", &Sampler::set_seed, py::arg("seed"))
+        .def("enable_cache", &Sampler::enable_cache, py::arg("memory_budget"))
+        .def("disable_cache", &Sampler::disable_cache)
+        .def_property_readonly("n_row", &Sampler::n_row)
+        .def_property_readonly("n_col", &Sampler::n_col)
+        .def_property_readonly("n_total", &Sampler::n_total);
+}
@@ -1,10 +1,42 @@
 /* patefield.cpp -- Public API for Patefield generators.
  * Copyright 2022 R. Urlus
  */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <patefield/cuda.hpp>
+#include <patefield/exact.hpp>
+#include <patefield/executor.hpp>
+#include <patefield/jobs.hpp>
+#if defined(PATEFIELD_HAS_MMAP_SUPPORT)
+#include <patefield/mapped.hpp>
+#endif
+#include <patefield/mpi.hpp>
 #include <patefield/patefield.hpp>
+#include <patefield/pvalue.hpp>
+#include <patefield/sparse.hpp>
+#include <patefield/statistics.hpp>
+#include <patefield/stats.hpp>
 
 namespace patefield {
 
+#if !defined(PATEFIELD_HAS_CUDA_SUPPORT)
+namespace details {
+
+void run_cuda_job(const CudaJob&) {
+    throw std::runtime_error("patefield: the library was built without CUDA support.\n");
+}
+
+int count_cuda_devices() {
+    return 0;
+}
+
+}  // namespace details
+#endif
+
 double* create_factorial_table(const int n_total) {
     return details::create_factorial_table(n_total);
 }
@@ -13,6 +45,30 @@ double* create_factorial_table(const int64_t n_total) {
     return details::create_factorial_table(n_total);
 }
 
+void set_factorial_table_limit(const int64_t n_max) {
+    details::set_max_stored_factorials(n_max);
+}
+
+void release_factorial_table() {
+    details::release_shared_factorials();
+}
+
+void set_executor(Executor* executor) {
+    details::set_executor(executor);
+}
+
+KernelStats kernel_stats() {
+    return details::collect_kernel_stats();
+}
+
+std::vector<KernelStats> thread_kernel_stats() {
+    return details::collect_thread_kernel_stats();
+}
+
+void reset_kernel_stats() {
+    details::reset_kernel_stats();
+}
+
 /* Generate a random two-way contingency table with given sums.
  *
  *  It is possible to specify row and column sum vectors which
@@ -29,9 +85,12 @@ double* create_factorial_table(const int64_t n_total) {
  *        default = 0, i.e. drawn by random_device.
  * factorial_table : optional, pointer to table containing the log factorials,
  *                   can be created using `patefield::create_factorial_table`
- *                   Otherwise the factorial_table will be computed.
+ *                   Otherwise the process-wide factorial table is used.
  * result : optional, pointer to the memory where the table will be stored,
- *          must be of size [n_row * n_col] and is expected to be C-contiguous
+ *          must be of size [n_row * n_col] and is stored using `layout`
+ * layout : optional, default = Layout::column_major, the memory layout of `result`,
+ *          cell (i, j) at `i + j * n_row`, `Layout::row_major` stores the cell
+ *          at `i * n_col + j`.
  *
  *  Returns
  *  -------
@@ -45,7 +104,8 @@ int* generate_contingency_table(
     int64_t n_total,
     uint64_t seed,
     double* factorial_table,
-    int* result
+    int* result,
+    const Layout layout
 ) {
     return details::generate_contingency_table<int>(
         n_row,
@@ -55,7 +115,8 @@ int* generate_contingency_table(
         n_total,
         seed,
         factorial_table,
-        result
+        result,
+        layout
     );
 } // generate_contingency_table
 
@@ -75,9 +136,12 @@ int* generate_contingency_table(
  *        default = 0, i.e. drawn by random_device.
  * factorial_table : optional, pointer to table containing the log factorials,
  *                   can be created using `patefield::create_factorial_table`
- *                   Otherwise the factorial_table will be computed.
+ *                   Otherwise the process-wide factorial table is used.
  * result : optional, pointer to the memory where the table will be stored,
- *          must be of size [n_row * n_col] and is expected to be C-contiguous
+ *          must be of size [n_row * n_col] and is stored using `layout`
+ * layout : optional, default = Layout::column_major, the memory layout of `result`,
+ *          cell (i, j) at `i + j * n_row`, `Layout::row_major` stores the cell
+ *          at `i * n_col + j`.
  *
  *  Returns
  *  -------
@@ -91,7 +155,8 @@ int64_t* generate_contingency_table(
     int64_t n_total,
     uint64_t seed,
     double* factorial_table,
-    int64_t* result
+    int64_t* result,
+    const Layout layout
 ) {
     return details::generate_contingency_table<int64_t>(
         n_row,
@@ -101,7 +166,8 @@ int64_t* generate_contingency_table(
         n_total,
         seed,
         factorial_table,
-        result
+        result,
+        layout
     );
 } // generate_contingency_table
 
@@ -124,9 +190,24 @@ int64_t* generate_contingency_table(
  *        default = 0, i.e. drawn by random_device.
  * factorial_table : optional, pointer to table containing the log factorials,
  *                   can be created using `patefield::create_factorial_table`
- *                   Otherwise the factorial_table will be computed.
- * result : optional, pointer to the memory where the table will be stored,
- *          must be of size [n_row * n_col] and is expected to be C-contiguous
+ *                   Otherwise the process-wide factorial table is used.
+ * result : optional, pointer to the memory where the tables will be stored,
+ *          must be of size [n_tables * n_row * n_col] and is stored using `layout`
+ * reproducible : optional, default = false, draw table `i` from its own
+ *                random stream derived from `seed` and `i` such that the
+ *                result does not depend on `n_threads`.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables, `Kernel::simd` generates `details::simd_lanes`
+ *          tables in lockstep.
+ * layout : optional, default = Layout::column_major, the memory layout of `result`,
+ *          table `i` starts at `i * n_row * n_col` and stores cell (i, j) at `i + j * n_row`.
+ *          `Layout::row_major` stores the cell at `i * n_col + j` and writes each table
+ *          sequentially, `Layout::cell_major` stores cell (i, j) of table `t`
+ *          at `(i * n_col + j) * n_tables + t`.
+ * reorder_marginals : optional, default = false, sample the rows and columns in
+ *                     the order that minimizes the work of the sampler, the
+ *                     tables are stored in the order of `n_row_sums` and `n_col_sums`.
+ *                     Only used by `Kernel::scalar` for batches of at least 200 tables.
  *
  *  Returns
  *  -------
@@ -142,7 +223,11 @@ int* generate_contingency_tables(
     const size_t n_threads,
     const uint64_t seed,
     double* factorial_table,
-    int* result
+    int* result,
+    const bool reproducible,
+    const Kernel kernel,
+    const Layout layout,
+    const bool reorder_marginals
 ) {
     return details::generate_contingency_tables<int>(
         n_tables,
@@ -154,7 +239,11 @@ int* generate_contingency_tables(
         n_threads,
         seed,
         factorial_table,
-        result
+        result,
+        reproducible,
+        kernel,
+        layout,
+        reorder_marginals
     );
 }
 
@@ -177,9 +266,24 @@ int* generate_contingency_tables(
  *        default = 0, i.e. drawn by random_device.
  * factorial_table : optional, pointer to table containing the log factorials,
  *                   can be created using `patefield::create_factorial_table`
- *                   Otherwise the factorial_table will be computed.
- * result : optional, pointer to the memory where the table will be stored,
- *          must be of size [n_row * n_col] and is expected to be C-contiguous
+ *                   Otherwise the process-wide factorial table is used.
+ * result : optional, pointer to the memory where the tables will be stored,
+ *          must be of size [n_tables * n_row * n_col] and is stored using `layout`
+ * reproducible : optional, default = false, draw table `i` from its own
+ *                random stream derived from `seed` and `i` such that the
+ *                result does not depend on `n_threads`.
+ * kernel : optional, default = Kernel::scalar, the kernel used to generate
+ *          the tables, `Kernel::simd` generates `details::simd_lanes`
+ *          tables in lockstep.
+ * layout : optional, default = Layout::column_major, the memory layout of `result`,
+ *          table `i` starts at `i * n_row * n_col` and stores cell (i, j) at `i + j * n_row`.
+ *          `Layout::row_major` stores the cell at `i * n_col + j` and writes each table
+ *          sequentially, `Layout::cell_major` stores cell (i, j) of table `t`
+ *          at `(i * n_col + j) * n_tables + t`.
+ * reorder_marginals : optional, default = false, sample the rows and columns in
+ *                     the order that minimizes the work of the sampler, the
+ *                     tables are stored in the order of `n_row_sums` and `n_col_sums`.
+ *                     Only used by `Kernel::scalar` for batches of at least 200 tables.
  *
  *  Returns
  *  -------
@@ -195,7 +299,11 @@ int64_t* generate_contingency_tables(
     const size_t n_threads,
     const uint64_t seed,
     double* factorial_table,
-    int64_t* result
+    int64_t* result,
+    const bool reproducible,
+    const Kernel kernel,
+    const Layout layout,
+    const bool reorder_marginals
 ) {
     return details::generate_contingency_tables<int64_t>(
         n_tables,
@@ -207,8 +315,883 @@ int64_t* generate_contingency_tables(
         n_threads,
         seed,
         factorial_table,
-        result
+        result,
+        reproducible,
+        kernel,
+        layout,
+        reorder_marginals
+    );
+}
+
+double compute_statistic(
+    const Statistic statistic,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    const int* table
+) {
+    return details::compute_statistic<int>(statistic, n_row, n_col, n_row_sums, n_col_sums, table);
+}
+
+double compute_statistic(
+    const Statistic statistic,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    const int64_t* table
+) {
+    return details::compute_statistic<int64_t>(statistic, n_row, n_col, n_row_sums, n_col_sums, table);
+}
+
+double* generate_statistics(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    double* result,
+    const bool reproducible,
+    const Kernel kernel
+) {
+    return details::generate_statistics<int>(
+        n_tables,
+        n_row,
+        n_col,
+        n_row_sums,
+        n_col_sums,
+        statistic,
+        n_total,
+        n_threads,
+        seed,
+        factorial_table,
+        result,
+        reproducible,
+        kernel
+    );
+}  // generate_statistics
+
+double* generate_statistics(
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    double* result,
+    const bool reproducible,
+    const Kernel kernel
+) {
+    return details::generate_statistics<int64_t>(
+        n_tables,
+        n_row,
+        n_col,
+        n_row_sums,
+        n_col_sums,
+        statistic,
+        n_total,
+        n_threads,
+        seed,
+        factorial_table,
+        result,
+        reproducible,
+        kernel
+    );
+}  // generate_statistics
+
+PValueResult monte_carlo_pvalue(
+    const int* observed,
+    const int n_row,
+    const int n_col,
+    const Statistic statistic,
+    const size_t max_tables,
+    const double tolerance,
+    const double confidence,
+    const size_t batch_size,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    const Kernel kernel
+) {
+    return details::monte_carlo_pvalue<int>(
+        observed,
+        n_row,
+        n_col,
+        statistic,
+        max_tables,
+        tolerance,
+        confidence,
+        batch_size,
+        n_threads,
+        seed,
+        factorial_table,
+        kernel
+    );
+}  // monte_carlo_pvalue
+
+PValueResult monte_carlo_pvalue(
+    const int64_t* observed,
+    const int64_t n_row,
+    const int64_t n_col,
+    const Statistic statistic,
+    const size_t max_tables,
+    const double tolerance,
+    const double confidence,
+    const size_t batch_size,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    const Kernel kernel
+) {
+    return details::monte_carlo_pvalue<int64_t>(
+        observed,
+        n_row,
+        n_col,
+        statistic,
+        max_tables,
+        tolerance,
+        confidence,
+        batch_size,
+        n_threads,
+        seed,
+        factorial_table,
+        kernel
+    );
+}  // monte_carlo_pvalue
+
+int* generate_contingency_table(
+    const int n_row,
+    const int n_col,
+    const int* const n_row_sums,
+    const int* const n_col_sums,
+    int64_t n_total,
+    pcg64_dxsm& rng,
+    double* factorial_table,
+    int* result,
+    const Layout layout
+) {
+    return details::generate_contingency_table<int>(
+        n_row, n_col, n_row_sums, n_col_sums, n_total, rng, factorial_table, result, layout
+    );
+}
+
+int64_t* generate_contingency_table(
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* const n_row_sums,
+    const int64_t* const n_col_sums,
+    int64_t n_total,
+    pcg64_dxsm& rng,
+    double* factorial_table,
+    int64_t* result,
+    const Layout layout
+) {
+    return details::generate_contingency_table<int64_t>(
+        n_row, n_col, n_row_sums, n_col_sums, n_total, rng, factorial_table, result, layout
+    );
+}
+
+int* generate_contingency_tables(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads,
+    pcg64_dxsm& rng,
+    double* factorial_table,
+    int* result,
+    const bool reproducible,
+    const Kernel kernel,
+    const Layout layout,
+    const bool reorder_marginals
+) {
+    return details::generate_contingency_tables<int>(
+        n_tables,
+        n_row,
+        n_col,
+        n_row_sums,
+        n_col_sums,
+        n_total,
+        n_threads,
+        details::draw_seed(rng),
+        factorial_table,
+        result,
+        reproducible,
+        kernel,
+        layout,
+        reorder_marginals
+    );
+}
+
+int64_t* generate_contingency_tables(
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads,
+    pcg64_dxsm& rng,
+    double* factorial_table,
+    int64_t* result,
+    const bool reproducible,
+    const Kernel kernel,
+    const Layout layout,
+    const bool reorder_marginals
+) {
+    return details::generate_contingency_tables<int64_t>(
+        n_tables,
+        n_row,
+        n_col,
+        n_row_sums,
+        n_col_sums,
+        n_total,
+        n_threads,
+        details::draw_seed(rng),
+        factorial_table,
+        result,
+        reproducible,
+        kernel,
+        layout,
+        reorder_marginals
+    );
+}
+
+uint8_t* generate_contingency_tables_u8(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    uint8_t* result,
+    const bool reproducible,
+    const Kernel kernel,
+    const Layout layout,
+    const bool reorder_marginals
+) {
+    return details::generate_contingency_tables<int, uint8_t>(
+        n_tables,
+        n_row,
+        n_col,
+        n_row_sums,
+        n_col_sums,
+        n_total,
+        n_threads,
+        seed,
+        factorial_table,
+        result,
+        reproducible,
+        kernel,
+        layout,
+        reorder_marginals
+    );
+}
+
+uint16_t* generate_contingency_tables_u16(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    uint16_t* result,
+    const bool reproducible,
+    const Kernel kernel,
+    const Layout layout,
+    const bool reorder_marginals
+) {
+    return details::generate_contingency_tables<int, uint16_t>(
+        n_tables,
+        n_row,
+        n_col,
+        n_row_sums,
+        n_col_sums,
+        n_total,
+        n_threads,
+        seed,
+        factorial_table,
+        result,
+        reproducible,
+        kernel,
+        layout,
+        reorder_marginals
+    );
+}
+
+uint32_t* generate_contingency_tables_u32(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    uint32_t* result,
+    const bool reproducible,
+    const Kernel kernel,
+    const Layout layout,
+    const bool reorder_marginals
+) {
+    return details::generate_contingency_tables<int, uint32_t>(
+        n_tables,
+        n_row,
+        n_col,
+        n_row_sums,
+        n_col_sums,
+        n_total,
+        n_threads,
+        seed,
+        factorial_table,
+        result,
+        reproducible,
+        kernel,
+        layout,
+        reorder_marginals
+    );
+}
+
+SparseTables<int> generate_sparse_tables(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    const bool reproducible
+) {
+    return details::generate_sparse_tables<int>(
+        n_tables,
+        n_row,
+        n_col,
+        n_row_sums,
+        n_col_sums,
+        n_total,
+        n_threads,
+        seed,
+        factorial_table,
+        reproducible
+    );
+}  // generate_sparse_tables
+
+SparseTables<int64_t> generate_sparse_tables(
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    const bool reproducible
+) {
+    return details::generate_sparse_tables<int64_t>(
+        n_tables,
+        n_row,
+        n_col,
+        n_row_sums,
+        n_col_sums,
+        n_total,
+        n_threads,
+        seed,
+        factorial_table,
+        reproducible
+    );
+}  // generate_sparse_tables
+
+void generate_jobs(
+    TableJob<int>* jobs,
+    const size_t n_jobs,
+    Executor& executor,
+    const size_t chunk_size,
+    double* factorial_table,
+    const Kernel kernel
+) {
+    details::generate_jobs<int>(jobs, n_jobs, executor, chunk_size, factorial_table, kernel);
+}  // generate_jobs
+
+void generate_jobs(
+    TableJob<int64_t>* jobs,
+    const size_t n_jobs,
+    Executor& executor,
+    const size_t chunk_size,
+    double* factorial_table,
+    const Kernel kernel
+) {
+    details::generate_jobs<int64_t>(jobs, n_jobs, executor, chunk_size, factorial_table, kernel);
+}  // generate_jobs
+
+#if defined(PATEFIELD_HAS_MMAP_SUPPORT)
+TableFileHeader generate_contingency_tables_to_file(
+    const std::string& path,
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    const bool reproducible,
+    const Kernel kernel,
+    const Layout layout
+) {
+    return details::generate_tables_to_file<int>(
+        path,
+        n_tables,
+        n_row,
+        n_col,
+        n_row_sums,
+        n_col_sums,
+        n_total,
+        n_threads,
+        seed,
+        factorial_table,
+        reproducible,
+        kernel,
+        layout
+    );
+}  // generate_contingency_tables_to_file
+
+TableFileHeader generate_contingency_tables_to_file(
+    const std::string& path,
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    const bool reproducible,
+    const Kernel kernel,
+    const Layout layout
+) {
+    return details::generate_tables_to_file<int64_t>(
+        path,
+        n_tables,
+        n_row,
+        n_col,
+        n_row_sums,
+        n_col_sums,
+        n_total,
+        n_threads,
+        seed,
+        factorial_table,
+        reproducible,
+        kernel,
+        layout
+    );
+}  // generate_contingency_tables_to_file
+#endif  // PATEFIELD_HAS_MMAP_SUPPORT
+
+size_t count_tables(
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    const size_t limit
+) {
+    return details::count_tables<int>(n_row, n_col, n_row_sums, n_col_sums, limit);
+}  // count_tables
+
+size_t count_tables(
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    const size_t limit
+) {
+    return details::count_tables<int64_t>(n_row, n_col, n_row_sums, n_col_sums, limit);
+}  // count_tables
+
+TableDistribution<int> enumerate_contingency_tables(
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    const size_t max_tables,
+    const size_t n_samples,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table
+) {
+    return details::enumerate_contingency_tables<int>(
+        n_row, n_col, n_row_sums, n_col_sums, max_tables, n_samples, n_threads, seed, factorial_table
+    );
+}  // enumerate_contingency_tables
+
+TableDistribution<int64_t> enumerate_contingency_tables(
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    const size_t max_tables,
+    const size_t n_samples,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table
+) {
+    return details::enumerate_contingency_tables<int64_t>(
+        n_row, n_col, n_row_sums, n_col_sums, max_tables, n_samples, n_threads, seed, factorial_table
+    );
+}  // enumerate_contingency_tables
+
+PValueResult exact_pvalue(
+    const int* observed,
+    const int n_row,
+    const int n_col,
+    const Statistic statistic,
+    const size_t max_tables,
+    double* factorial_table
+) {
+    return details::exact_pvalue<int>(observed, n_row, n_col, statistic, max_tables, factorial_table);
+}  // exact_pvalue
+
+PValueResult exact_pvalue(
+    const int64_t* observed,
+    const int64_t n_row,
+    const int64_t n_col,
+    const Statistic statistic,
+    const size_t max_tables,
+    double* factorial_table
+) {
+    return details::exact_pvalue<int64_t>(observed, n_row, n_col, statistic, max_tables, factorial_table);
+}  // exact_pvalue
+
+PValueResult adaptive_pvalue(
+    const int* observed,
+    const int n_row,
+    const int n_col,
+    const Statistic statistic,
+    const size_t max_enumerated,
+    const size_t max_tables,
+    const double tolerance,
+    const double confidence,
+    const size_t batch_size,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    const Kernel kernel
+) {
+    return details::adaptive_pvalue<int>(
+        observed, n_row, n_col, statistic, max_enumerated, max_tables, tolerance, confidence, batch_size, n_threads,
+        seed, factorial_table, kernel
+    );
+}  // adaptive_pvalue
+
+PValueResult adaptive_pvalue(
+    const int64_t* observed,
+    const int64_t n_row,
+    const int64_t n_col,
+    const Statistic statistic,
+    const size_t max_enumerated,
+    const size_t max_tables,
+    const double tolerance,
+    const double confidence,
+    const size_t batch_size,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    const Kernel kernel
+) {
+    return details::adaptive_pvalue<int64_t>(
+        observed, n_row, n_col, statistic, max_enumerated, max_tables, tolerance, confidence, batch_size, n_threads,
+        seed, factorial_table, kernel
     );
+}  // adaptive_pvalue
+
+int cuda_device_count() {
+    return details::count_cuda_devices();
 }
 
+int* generate_contingency_tables_cuda(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total,
+    const uint64_t seed,
+    double* factorial_table,
+    int* result,
+    const int device
+) {
+    return details::generate_contingency_tables_cuda<int>(
+        n_tables, n_row, n_col, n_row_sums, n_col_sums, n_total, seed, factorial_table, result, device
+    );
+}  // generate_contingency_tables_cuda
+
+int64_t* generate_contingency_tables_cuda(
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    int64_t n_total,
+    const uint64_t seed,
+    double* factorial_table,
+    int64_t* result,
+    const int device
+) {
+    return details::generate_contingency_tables_cuda<int64_t>(
+        n_tables, n_row, n_col, n_row_sums, n_col_sums, n_total, seed, factorial_table, result, device
+    );
+}  // generate_contingency_tables_cuda
+
+double* generate_statistics_cuda(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total,
+    const uint64_t seed,
+    double* factorial_table,
+    double* result,
+    const int device
+) {
+    return details::generate_statistics_cuda<int>(
+        n_tables, n_row, n_col, n_row_sums, n_col_sums, statistic, n_total, seed, factorial_table, result, device
+    );
+}  // generate_statistics_cuda
+
+double* generate_statistics_cuda(
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total,
+    const uint64_t seed,
+    double* factorial_table,
+    double* result,
+    const int device
+) {
+    return details::generate_statistics_cuda<int64_t>(
+        n_tables, n_row, n_col, n_row_sums, n_col_sums, statistic, n_total, seed, factorial_table, result, device
+    );
+}  // generate_statistics_cuda
+
+uint64_t count_statistics_cuda(
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    const Statistic statistic,
+    const double threshold,
+    int64_t n_total,
+    const uint64_t seed,
+    double* factorial_table,
+    const int device
+) {
+    return details::count_statistics_cuda<int>(
+        n_tables, n_row, n_col, n_row_sums, n_col_sums, statistic, threshold, n_total, seed, factorial_table, device
+    );
+}  // count_statistics_cuda
+
+uint64_t count_statistics_cuda(
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    const Statistic statistic,
+    const double threshold,
+    int64_t n_total,
+    const uint64_t seed,
+    double* factorial_table,
+    const int device
+) {
+    return details::count_statistics_cuda<int64_t>(
+        n_tables, n_row, n_col, n_row_sums, n_col_sums, statistic, threshold, n_total, seed, factorial_table, device
+    );
+}  // count_statistics_cuda
+
+#if defined(PATEFIELD_HAS_MPI_SUPPORT)
+RankRange mpi_rank_range(MPI_Comm comm, const size_t n_tables) {
+    return details::mpi_rank_range(comm, n_tables);
+}
+
+int* generate_contingency_tables_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    int* result,
+    const Kernel kernel
+) {
+    return details::generate_contingency_tables_mpi<int>(
+        comm, n_tables, n_row, n_col, n_row_sums, n_col_sums, n_total, n_threads, seed, factorial_table, result,
+        kernel
+    );
+}  // generate_contingency_tables_mpi
+
+int64_t* generate_contingency_tables_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    int64_t* result,
+    const Kernel kernel
+) {
+    return details::generate_contingency_tables_mpi<int64_t>(
+        comm, n_tables, n_row, n_col, n_row_sums, n_col_sums, n_total, n_threads, seed, factorial_table, result,
+        kernel
+    );
+}  // generate_contingency_tables_mpi
+
+double* generate_statistics_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const int n_row,
+    const int n_col,
+    const int* n_row_sums,
+    const int* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    double* result,
+    const Kernel kernel
+) {
+    return details::generate_statistics_mpi<int>(
+        comm, n_tables, n_row, n_col, n_row_sums, n_col_sums, statistic, n_total, n_threads, seed,
+        factorial_table, result, kernel
+    );
+}  // generate_statistics_mpi
+
+double* generate_statistics_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const int64_t n_row,
+    const int64_t n_col,
+    const int64_t* n_row_sums,
+    const int64_t* n_col_sums,
+    const Statistic statistic,
+    int64_t n_total,
+    const size_t n_threads,
+    const uint64_t seed,
+    double* factorial_table,
+    double* result,
+    const Kernel kernel
+) {
+    return details::generate_statistics_mpi<int64_t>(
+        comm, n_tables, n_row, n_col, n_row_sums, n_col_sums, statistic, n_total, n_threads, seed,
+        factorial_table, result, kernel
+    );
+}  // generate_statistics_mpi
+
+void gather_statistics_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const double* local,
+    double* result,
+    const int root
+) {
+    int rank = 0;
+    int n_ranks = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &n_ranks);
+    // the counts of MPI_Gatherv are ints
+    if (n_tables > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        throw InputError("patefield: too many tables to gather, reduce the statistics instead.\n");
+    }
+    std::vector<int> counts(static_cast<size_t>(n_ranks));
+    std::vector<int> offsets(static_cast<size_t>(n_ranks));
+    for (int r = 0; r < n_ranks; r++) {
+        const RankRange range = details::rank_range(n_tables, static_cast<size_t>(r), static_cast<size_t>(n_ranks));
+        counts[static_cast<size_t>(r)] = static_cast<int>(range.n_tables);
+        offsets[static_cast<size_t>(r)] = static_cast<int>(range.first);
+    }
+    MPI_Gatherv(
+        local, counts[static_cast<size_t>(rank)], MPI_DOUBLE, result, counts.data(), offsets.data(), MPI_DOUBLE,
+        root, comm
+    );
+}  // gather_statistics_mpi
+
+uint64_t count_statistics_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const double* local,
+    const double threshold
+) {
+    const RankRange range = details::mpi_rank_range(comm, n_tables);
+    uint64_t count = static_cast<uint64_t>(
+        std::count_if(local, local + range.n_tables, [threshold](const double value) { return value >= threshold; })
+    );
+    MPI_Allreduce(MPI_IN_PLACE, &count, 1, MPI_UINT64_T, MPI_SUM, comm);
+    return count;
+}  // count_statistics_mpi
+
+void histogram_statistics_mpi(
+    MPI_Comm comm,
+    const size_t n_tables,
+    const double* local,
+    const size_t n_bins,
+    const double lower,
+    const double upper,
+    uint64_t* counts
+) {
+    if (n_bins == 0) {
+        throw InputError("patefield: n_bins must be positive.\n");
+    }
+    if (!(upper > lower)) {
+        throw InputError("patefield: upper must be larger than lower.\n");
+    }
+    const RankRange range = details::mpi_rank_range(comm, n_tables);
+    std::fill(counts, counts + n_bins, uint64_t(0));
+    const double scale = static_cast<double>(n_bins) / (upper - lower);
+    for (size_t i = 0; i < range.n_tables; i++) {
+        const double bin = std::floor((local[i] - lower) * scale);
+        const double last = static_cast<double>(n_bins - 1);
+        const size_t index = bin > 0.0 ? static_cast<size_t>(std::min(bin, last)) : 0;
+        counts[index]++;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, counts, static_cast<int>(n_bins), MPI_UINT64_T, MPI_SUM, comm);
+}  // histogram_statistics_mpi
+#endif  // PATEFIELD_HAS_MPI_SUPPORT
+
 }  // namespace patefield
@@ -0,0 +1,473 @@
+/* patefield_cuda.cu -- CUDA kernels of the Patefield generators.
+ * Copyright 2022 R. Urlus
+ *
+ * Every thread draws one table with the algorithm of `rcont2`, the cells
+ * are computed in 64 bits. The column sums that remain and, when only the
+ * statistics are needed, the tables are stored interleaved over the
+ * threads such that the accesses of a warp are coalesced. The tables are
+ * generated in batches that bound the device memory.
+ */
+#include <cuda_runtime.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <patefield/cuda_backend.hpp>
+
+namespace patefield {
+namespace details {
+namespace {
+
+constexpr int threads_per_block = 128;
+
+// device memory for the tables and scratch space of a batch
+constexpr size_t max_batch_bytes = size_t(256) << 20;
+
+// values of `Statistic`, other values are chi-square
+constexpr int g_test_statistic = 1;
+constexpr int mutual_information_statistic = 2;
+constexpr int cramers_v_statistic = 3;
+
+void check_cuda(const cudaError_t status, const char* what) {
+    if (status != cudaSuccess) {
+        throw std::runtime_error(
+            std::string("patefield: ") + what + " failed: " + cudaGetErrorString(status) + "\n"
+        );
+    }
+}
+
+/* Device memory for `n` values of `V`, released on destruction. */
+template<typename V>
+class DeviceBuffer {
+    V* data_ = nullptr;
+
+ public:
+    explicit DeviceBuffer(const size_t n) {
+        if (n > 0) {
+            check_cuda(cudaMalloc(reinterpret_cast<void**>(&data_), n * sizeof(V)), "cudaMalloc");
+        }
+    }
+
+    ~DeviceBuffer() {
+        if (data_) {
+            cudaFree(data_);
+        }
+    }
+
+    DeviceBuffer(const DeviceBuffer&) = delete;
+    DeviceBuffer& operator=(const DeviceBuffer&) = delete;
+
+    V* get() const { return data_; }
+
+    void upload(const V* values, const size_t n) {
+        check_cuda(cudaMemcpy(data_, values, n * sizeof(V), cudaMemcpyHostToDevice), "cudaMemcpy");
+    }
+
+    void download(V* values, const size_t n) const {
+        check_cuda(cudaMemcpy(values, data_, n * sizeof(V), cudaMemcpyDeviceToHost), "cudaMemcpy");
+    }
+};  // DeviceBuffer
+
+/* pcg64_dxsm with the 128-bit state and increment stored as two halves.
+ *
+ *  Produces the outputs of `pcg64_dxsm` seeded by `rng.seed(seed, stream)`.
+ */
+struct DevicePcg64 {
+    uint64_t state_hi;
+    uint64_t state_lo;
+    uint64_t inc_hi;
+    uint64_t inc_lo;
+
+    /* state = state * multiplier + increment, modulo 2^128 */
+    __device__ inline void bump() {
+        constexpr uint64_t mult_hi = 2549297995355413924ULL;
+        constexpr uint64_t mult_lo = 4865540595714422341ULL;
+        const uint64_t lo = state_lo * mult_lo;
+        const uint64_t hi = __umul64hi(state_lo, mult_lo) + state_hi * mult_lo + state_lo * mult_hi;
+        state_lo = lo + inc_lo;
+        state_hi = hi + inc_hi + (state_lo < lo ? 1 : 0);
+    }
+
+    __device__ inline void seed(const uint64_t seed, const uint64_t stream) {
+        inc_hi = stream >> 63;
+        inc_lo = (stream << 1) | 1;
+        state_lo = seed + inc_lo;
+        state_hi = inc_hi + (state_lo < inc_lo ? 1 : 0);
+        bump();
+    }
+
+    __device__ inline uint64_t operator()() {
+        bump();
+        uint64_t hi = state_hi;
+        const uint64_t lo = state_lo | 1;
+        hi ^= hi >> 32;
+        hi *= 0xda942042e4dd58b5ULL;
+        hi ^= hi >> 48;
+        hi *= lo;
+        return hi;
+    }
+};  // DevicePcg64
+
+/* Uniform over the open set (0, 1), see `bits_to_open_uniform`. */
+__device__ inline double open_uniform(DevicePcg64& rng) {
+    return (static_cast<double>(rng() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+/* Log-factorials of [0, n_stored], larger arguments use the Stirling series as `LogFactorial`. */
+struct DeviceFactorials {
+    const double* table;
+    int64_t n_stored;
+
+    __device__ inline double operator[](const int64_t n) const {
+        if (n <= n_stored) {
+            return __ldg(table + n);
+        }
+        constexpr double half_log_two_pi = 0.91893853320467274178;
+        const double x = static_cast<double>(n);
+        const double inv = 1.0 / x;
+        const double inv2 = inv * inv;
+        return (x + 0.5) * log(x) - x + half_log_two_pi
+            + inv * (1.0 / 12.0 - inv2 * (1.0 / 360.0 - inv2 * (1.0 / 1260.0)));
+    }
+};  // DeviceFactorials
+
+/* Walk outwards from the mode, see `rcont2_walk`. */
+__device__ int64_t walk_from_mode(
+    const int64_t ia,
+    const int64_t id,
+    const int64_t ii,
+    const int64_t nlm,
+    const double x,
+    double r,
+    DevicePcg64& rng
+) {
+    for (;;) {
+        if (r <= x) {
+            return nlm;
+        }
+        double sumprb = x;
+        double xu = x;
+        double y = x;
+        int64_t nlu = nlm;
+        int64_t nll = nlm;
+        bool lsp = false;
+        bool lsm = false;
+
+        while (!lsp) {
+            const int64_t j = (id - nlu) * (ia - nlu);
+            if (j == 0) {
+                lsp = true;
+            } else {
+                nlu += 1;
+                xu = xu * static_cast<double>(j) / static_cast<double>(nlu * (ii + nlu));
+                sumprb += xu;
+                if (r <= sumprb) {
+                    return nlu;
+                }
+            }
+
+            while (!lsm) {
+                const int64_t k = nll * (ii + nll);
+                if (k == 0) {
+                    lsm = true;
+                    break;
+                }
+                nll -= 1;
+                y = y * static_cast<double>(k) / static_cast<double>((id - nll) * (ia - nll));
+                sumprb += y;
+                if (r <= sumprb) {
+                    return nll;
+                }
+                if (!lsp) {
+                    break;
+                }
+            }
+        }
+        r = sumprb * open_uniform(rng);
+    }
+}  // walk_from_mode
+
+/* Draw a cell given the remaining row sum, column sum and total, see `ModeWalk`. */
+__device__ inline int64_t draw_cell(
+    const int64_t ia,
+    const int64_t id,
+    const int64_t ie,
+    const DeviceFactorials& factorials,
+    DevicePcg64& rng
+) {
+    const int64_t ic = ie - id;
+    const int64_t ib = ie - ia;
+    const int64_t ii = ib - id;
+    const double r = open_uniform(rng);
+    const int64_t nlm = static_cast<int64_t>(
+        static_cast<double>(ia) * static_cast<double>(id) / static_cast<double>(ie) + 0.5
+    );
+    const int64_t iap = ia + 1;
+    const int64_t idp = id + 1;
+    const int64_t igp = idp - nlm;
+    const int64_t ihp = iap - nlm;
+    const int64_t nlmp = nlm + 1;
+    const int64_t iip = ii + nlmp;
+    const double x = exp(
+        factorials[iap - 1] + factorials[ib] + factorials[ic] + factorials[idp - 1]
+        - factorials[ie] - factorials[nlmp - 1] - factorials[igp - 1]
+        - factorials[ihp - 1] - factorials[iip - 1]);
+    return walk_from_mode(ia, id, ii, nlm, x, r, rng);
+}  // draw_cell
+
+/* The tables [first, first + n_tables) of a batch, the pointers are device memory. */
+struct BatchArgs {
+    size_t first;
+    size_t n_tables;
+    int64_t n_row;
+    int64_t n_col;
+    int64_t n_total;
+    const int64_t* n_row_sums;
+    const int64_t* n_col_sums;
+    uint64_t seed;
+    DeviceFactorials factorials;
+    // remaining column sums, entry m of table t at `m * n_tables + t`
+    int64_t* jwork;
+};  // BatchArgs
+
+/* Draw table `t` of the batch, cell (l, m) is stored at `cells[(l + m * n_row) * cell_stride]`. */
+template<typename S>
+__device__ void draw_table(const BatchArgs& args, const size_t t, S* cells, const size_t cell_stride) {
+    const int64_t n_row = args.n_row;
+    const int64_t n_col = args.n_col;
+    const size_t jstride = args.n_tables;
+    int64_t* jwork = args.jwork + t;
+    auto cell = [&](const int64_t l, const int64_t m) -> S& {
+        return cells[static_cast<size_t>(l + m * n_row) * cell_stride];
+    };
+
+    DevicePcg64 rng;
+    rng.seed(args.seed, args.first + t);
+
+    for (int64_t i = 0; i < n_col - 1; i++) {
+        jwork[i * jstride] = args.n_col_sums[i];
+    }
+    int64_t jc = args.n_total;
+    // set by the first cell, n_col >= 2
+    int64_t ib = 0;
+
+    for (int64_t l = 0; l < n_row - 1; l++) {
+        const int64_t n_row_sumsl = args.n_row_sums[l];
+        int64_t ia = n_row_sumsl;
+        int64_t ic = jc;
+        jc -= n_row_sumsl;
+
+        for (int64_t m = 0; m < n_col - 1; m++) {
+            const int64_t id = jwork[m * jstride];
+            const int64_t ie = ic;
+            ic = ic - id;
+            ib = ie - ia;
+
+            //  Test for zero entries in matrix.
+            if (ie == 0) {
+                ia = 0;
+                for (int64_t j = m; j < n_col - 1; j++) {
+                    cell(l, j) = 0;
+                }
+                break;
+            }
+
+            const int64_t nlm = draw_cell(ia, id, ie, args.factorials, rng);
+            cell(l, m) = static_cast<S>(nlm);
+            ia -= nlm;
+            jwork[m * jstride] -= nlm;
+        }
+        cell(l, n_col - 1) = static_cast<S>(ia);
+    }
+    //  Compute the last row.
+    for (int64_t j = 0; j < n_col - 1; j++) {
+        cell(n_row - 1, j) = static_cast<S>(jwork[j * jstride]);
+    }
+    cell(n_row - 1, n_col - 1) = static_cast<S>(ib - jwork[(n_col - 2) * jstride]);
+}  // draw_table
+
+/* The terms of `TableStatistic` and the outputs of the reduction, device memory. */
+struct StatisticArgs {
+    int statistic;
+    const double* inv_expected;
+    double n_total;
+    double g_offset;
+    double cramers_scale;
+    double* result;
+    unsigned long long* count;
+    double threshold;
+};  // StatisticArgs
+
+/* The statistic of a table stored with `cell_stride`, summed in the order of `TableStatistic`. */
+__device__ double table_statistic(
+    const StatisticArgs& stat,
+    const int64_t* cells,
+    const size_t cell_stride,
+    const size_t block_size
+) {
+    double acc = 0.0;
+    if (stat.statistic == g_test_statistic || stat.statistic == mutual_information_statistic) {
+        for (size_t k = 0; k < block_size; k++) {
+            const int64_t value = cells[k * cell_stride];
+            if (value > 0) {
+                const double o = static_cast<double>(value);
+                acc += o * log(o);
+            }
+        }
+        const double g = fmax(2.0 * (acc + stat.g_offset), 0.0);
+        return stat.statistic == g_test_statistic ? g : g / (2.0 * stat.n_total);
+    }
+    for (size_t k = 0; k < block_size; k++) {
+        const double o = static_cast<double>(cells[k * cell_stride]);
+        acc += o * o * __ldg(stat.inv_expected + k);
+    }
+    const double chi2 = fmax(acc - stat.n_total, 0.0);
+    return stat.statistic == cramers_v_statistic ? sqrt(chi2 * stat.cramers_scale) : chi2;
+}  // table_statistic
+
+/* One table per thread, table `t` of the batch at `tables + t * n_row * n_col`. */
+template<typename S>
+__global__ void tables_kernel(const BatchArgs args, S* tables) {
+    const size_t t = static_cast<size_t>(blockIdx.x) * blockDim.x + threadIdx.x;
+    if (t >= args.n_tables) {
+        return;
+    }
+    const size_t block_size = static_cast<size_t>(args.n_row * args.n_col);
+    draw_table<S>(args, t, tables + t * block_size, 1);
+}  // tables_kernel
+
+/* One table per thread reduced to its statistic, `scratch` holds the tables interleaved. */
+__global__ void statistics_kernel(const BatchArgs args, const StatisticArgs stat, int64_t* scratch) {
+    const size_t t = static_cast<size_t>(blockIdx.x) * blockDim.x + threadIdx.x;
+    const size_t block_size = static_cast<size_t>(args.n_row * args.n_col);
+    bool hit = false;
+    if (t < args.n_tables) {
+        draw_table<int64_t>(args, t, scratch + t, args.n_tables);
+        const double value = table_statistic(stat, scratch + t, args.n_tables, block_size);
+        if (stat.result) {
+            stat.result[t] = value;
+        }
+        hit = value >= stat.threshold;
+    }
+    if (stat.count) {
+        // every thread of the block takes this branch, one atomic per block
+        const int n_hits = __syncthreads_count(hit);
+        if (threadIdx.x == 0 && n_hits > 0) {
+            atomicAdd(stat.count, static_cast<unsigned long long>(n_hits));
+        }
+    }
+}  // statistics_kernel
+
+}  // namespace
+
+void run_cuda_job(const CudaJob& job) {
+    if (job.count) {
+        *job.count = 0;
+    }
+    if (job.n_tables == 0) {
+        return;
+    }
+    check_cuda(cudaSetDevice(job.device), "cudaSetDevice");
+
+    const size_t n_row = static_cast<size_t>(job.n_row);
+    const size_t n_col = static_cast<size_t>(job.n_col);
+    const size_t block_size = n_row * n_col;
+    const bool tables = job.tables != nullptr;
+    const size_t cell_bytes = tables && job.int_tables ? sizeof(int) : sizeof(int64_t);
+    const size_t table_bytes = block_size * cell_bytes;
+    const size_t bytes_per_table = table_bytes + (n_col - 1) * sizeof(int64_t) + sizeof(double);
+    const size_t batch = std::max<size_t>(std::min(job.n_tables, max_batch_bytes / bytes_per_table), 1);
+
+    // only the arguments up to the total are looked up
+    const int64_t n_stored = std::min(job.n_stored, job.n_total);
+    DeviceBuffer<int64_t> row_sums(n_row);
+    DeviceBuffer<int64_t> col_sums(n_col);
+    DeviceBuffer<double> factorials(static_cast<size_t>(n_stored + 1));
+    DeviceBuffer<double> inv_expected(tables ? 0 : block_size);
+    DeviceBuffer<int64_t> jwork((n_col - 1) * batch);
+    DeviceBuffer<unsigned char> cells(batch * table_bytes);
+    DeviceBuffer<double> statistics(job.statistics ? batch : 0);
+    DeviceBuffer<unsigned long long> count(job.count ? 1 : 0);
+    row_sums.upload(job.n_row_sums, n_row);
+    col_sums.upload(job.n_col_sums, n_col);
+    factorials.upload(job.factorial_table, static_cast<size_t>(n_stored + 1));
+    if (!tables) {
+        inv_expected.upload(job.inv_expected, block_size);
+    }
+    if (job.count) {
+        check_cuda(cudaMemset(count.get(), 0, sizeof(unsigned long long)), "cudaMemset");
+    }
+
+    BatchArgs args;
+    args.n_row = job.n_row;
+    args.n_col = job.n_col;
+    args.n_total = job.n_total;
+    args.n_row_sums = row_sums.get();
+    args.n_col_sums = col_sums.get();
+    args.seed = job.seed;
+    args.factorials = DeviceFactorials{factorials.get(), n_stored};
+    args.jwork = jwork.get();
+
+    StatisticArgs stat;
+    stat.statistic = job.statistic;
+    stat.inv_expected = inv_expected.get();
+    stat.n_total = static_cast<double>(job.n_total);
+    stat.g_offset = job.g_offset;
+    stat.cramers_scale = job.cramers_scale;
+    stat.result = statistics.get();
+    stat.count = count.get();
+    stat.threshold = job.threshold;
+
+    for (size_t first = 0; first < job.n_tables; first += batch) {
+        const size_t n = std::min(batch, job.n_tables - first);
+        const unsigned int n_blocks = static_cast<unsigned int>((n + threads_per_block - 1) / threads_per_block);
+        args.first = first;
+        args.n_tables = n;
+        if (tables) {
+            if (job.int_tables) {
+                tables_kernel<int><<<n_blocks, threads_per_block>>>(args, reinterpret_cast<int*>(cells.get()));
+            } else {
+                tables_kernel<int64_t><<<n_blocks, threads_per_block>>>(
+                    args, reinterpret_cast<int64_t*>(cells.get())
+                );
+            }
+            check_cuda(cudaGetLastError(), "kernel launch");
+            // waits for the kernel
+            check_cuda(
+                cudaMemcpy(
+                    static_cast<unsigned char*>(job.tables) + first * table_bytes, cells.get(), n * table_bytes,
+                    cudaMemcpyDeviceToHost
+                ),
+                "cudaMemcpy"
+            );
+        } else {
+            statistics_kernel<<<n_blocks, threads_per_block>>>(args, stat, reinterpret_cast<int64_t*>(cells.get()));
+            check_cuda(cudaGetLastError(), "kernel launch");
+            if (job.statistics) {
+                statistics.download(job.statistics + first, n);
+            }
+        }
+    }
+    check_cuda(cudaDeviceSynchronize(), "kernel");
+    if (job.count) {
+        unsigned long long n_hits = 0;
+        count.download(&n_hits, 1);
+        *job.count = static_cast<uint64_t>(n_hits);
+    }
+}  // run_cuda_job
+
+int count_cuda_devices() {
+    int n_devices = 0;
+    if (cudaGetDeviceCount(&n_devices) != cudaSuccess) {
+        // clear the error, no driver or no device
+        cudaGetLastError();
+        return 0;
+    }
+    return n_devices;
+}  // count_cuda_devices
+
+}  // namespace details
+}  // namespace patefield